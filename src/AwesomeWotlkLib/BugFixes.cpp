@@ -1,6 +1,7 @@
 #include "BugFixes.h"
 #include <Windows.h>
 #include "Utils.h"
+#include "StartupTrace.h"
 #include <Detours/detours.h>
 #include <string>
 
@@ -21,6 +22,6 @@ static BOOL Clipboard_SetString_hk(const char* buf, HWND hwnd) { return CopyToCl
 
 void BugFixes::initialize()
 {
-    DetourAttach(&(LPVOID&)Clipboard_GetString_orig, Clipboard_GetString_hk);
-    DetourAttach(&(LPVOID&)Clipboard_SetString_orig, Clipboard_SetString_hk);
+    DETOUR_ATTACH_TRACED(Clipboard_GetString_orig, Clipboard_GetString_hk);
+    DETOUR_ATTACH_TRACED(Clipboard_SetString_orig, Clipboard_SetString_hk);
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "CVarAPI.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Handles let addons read cvars without hashing the name on every call. Handle is light userdata
+    holding index of cached entry, entry keeps parsed value which is updated by wrapping change
+    handler of the cvar. Entries live until process exit, cvars are never unregistered.
+*/
+
+struct CVarHandle {
+    Console::CVar* cvar;
+    Console::CVar::Handler_t handler;
+    void* userData;
+    double value;
+};
+
+static std::vector<std::unique_ptr<CVarHandle>> s_handles;
+static std::unordered_map<Console::CVar*, size_t> s_handleIds;
+
+static double parseValue(const char* str) { return str ? atof(str) : 0.0; }
+
+static int CVarHandler_Wrapped(Console::CVar* cvar, const char* prevVal, const char* newVal, void* userData)
+{
+    CVarHandle* handle = (CVarHandle*)userData;
+    int result = handle->handler ? handle->handler(cvar, prevVal, newVal, handle->userData) : 1;
+    if (result) handle->value = parseValue(newVal);
+    return result;
+}
+
+static CVarHandle* lua_tocvarhandle(lua_State* L, int idx)
+{
+    if (!lua_islightuserdata(L, idx)) return NULL;
+    size_t id = (size_t)lua_touserdata(L, idx);
+    return id && id <= s_handles.size() ? s_handles[id - 1].get() : NULL;
+}
+
+static int C_CVar_GetHandle(lua_State* L)
+{
+    Console::CVar* cvar = Console::FindCVar(luaL_checkstring(L, 1));
+    if (!cvar) return 0;
+
+    auto it = s_handleIds.find(cvar);
+    size_t id;
+    if (it != s_handleIds.end()) {
+        id = it->second;
+    } else {
+        CVarHandle* handle = s_handles.emplace_back(std::make_unique<CVarHandle>()).get();
+        handle->cvar = cvar;
+        handle->handler = cvar->handler;
+        handle->userData = cvar->userData;
+        handle->value = parseValue(cvar->vStr);
+        cvar->handler = CVarHandler_Wrapped;
+        cvar->userData = handle;
+        id = s_handles.size();
+        s_handleIds[cvar] = id;
+    }
+    lua_pushlightuserdata(L, (void*)id);
+    return 1;
+}
+
+static int C_CVar_GetNumber(lua_State* L)
+{
+    CVarHandle* handle = lua_tocvarhandle(L, 1);
+    if (!handle) return 0;
+    lua_pushnumber(L, handle->value);
+    return 1;
+}
+
+static int C_CVar_SetNumber(lua_State* L)
+{
+    CVarHandle* handle = lua_tocvarhandle(L, 1);
+    double value = luaL_checknumber(L, 2);
+    if (!handle) return 0;
+    // Same restrictions as for SetCVar, protected cvars aren't accessible through handles
+    if (handle->cvar->flags & (Console::CVarFlags_ReadOnly | Console::CVarFlags_ReadOnlyForUser | Console::CVarFlags_CheckTaint))
+        return 0;
+    if (value == handle->value) {
+        lua_pushnumber(L, 1);
+        return 1;
+    }
+
+    char buf[32];
+    if (value == std::floor(value) && std::fabs(value) < 1e15)
+        snprintf(buf, std::size(buf), "%.0f", value);
+    else
+        snprintf(buf, std::size(buf), "%.9g", value);
+    Console::SetCVarValue(handle->cvar, buf, 1, 0, 0, 1);
+    if (handle->value != parseValue(buf)) return 0;
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int lua_openlibcvar(lua_State* L)
+{
+    luaL_Reg methods[] = {
+        {"GetHandle", C_CVar_GetHandle},
+        {"GetNumber", C_CVar_GetNumber},
+        {"SetNumber", C_CVar_SetNumber},
+    };
+
+    lua_createtable(L, 0, std::size(methods));
+    for (size_t i = 0; i < std::size(methods); i++) {
+        lua_pushcfunction(L, methods[i].func);
+        lua_setfield(L, -2, methods[i].name);
+    }
+    lua_setglobal(L, "C_CVar");
+    return 0;
+}
+
+void CVarAPI::initialize()
+{
+    Hooks::FrameXML::registerLuaLib(lua_openlibcvar);
+}
\ No newline at end of file
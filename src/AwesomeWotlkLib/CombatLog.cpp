@@ -0,0 +1,182 @@
+#include "CombatLog.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define COMBAT_LOG_EVENT_UNFILTERED "COMBAT_LOG_EVENT_UNFILTERED"
+
+/*
+    Frames registered through RegisterCombatLogEvent get COMBAT_LOG_EVENT_UNFILTERED only for listed subevents
+    and units whose guid matches (guid & mask) == (value & mask). Event arguments on stack are:
+    event, timestamp, subevent, sourceGUID, sourceName, sourceFlags, destGUID, destName, destFlags, ...
+*/
+struct CombatLogFilter {
+    Frame* frame;
+    std::vector<std::pair<uint32_t, std::string>> subevents; // (hash, name), empty matches any
+    guid_t sourceMask, sourceGuid;
+    guid_t destMask, destGuid;
+    uint32_t hits;
+};
+
+static std::vector<CombatLogFilter> s_filters;
+static int s_eventId = -1;
+
+static uint32_t hashString(const char* str)
+{
+    uint32_t hash = 2166136261u;
+    for (; *str; str++)
+        hash = (hash ^ (uint8_t)*str) * 16777619u;
+    return hash;
+}
+
+static bool matchSubevent(const CombatLogFilter& filter, uint32_t hash, const char* subevent)
+{
+    if (filter.subevents.empty()) return true;
+    for (auto& [h, name] : filter.subevents)
+        if (h == hash && name == subevent)
+            return true;
+    return false;
+}
+
+static guid_t argGuid(lua_State* L, int idx, bool& parsed, guid_t& guid)
+{
+    if (!parsed) {
+        const char* str = lua_tolstring(L, idx, NULL);
+        guid = str ? ObjectMgr::HexString2Guid(str) : 0;
+        parsed = true;
+    }
+    return guid;
+}
+
+static void onFireEvent(int eventId, lua_State* L, int nargs)
+{
+    if (s_filters.empty() || eventId != s_eventId || nargs < 7) return;
+
+    const char* subevent = lua_tolstring(L, -nargs + 2, NULL);
+    if (!subevent) return;
+    uint32_t hash = hashString(subevent);
+
+    // Guids are parsed only if some filter needs them
+    bool sourceParsed = false, destParsed = false;
+    guid_t source = 0, dest = 0;
+
+    // Handlers may (un)register during dispatch, so collect first
+    static std::vector<Frame*> s_dispatch;
+    size_t begin = s_dispatch.size();
+    for (CombatLogFilter& filter : s_filters) {
+        if (!matchSubevent(filter, hash, subevent)) continue;
+        if (filter.sourceMask && (argGuid(L, -nargs + 3, sourceParsed, source) & filter.sourceMask) != filter.sourceGuid) continue;
+        if (filter.destMask && (argGuid(L, -nargs + 6, destParsed, dest) & filter.destMask) != filter.destGuid) continue;
+        filter.hits++;
+        s_dispatch.push_back(filter.frame);
+    }
+
+    for (size_t i = begin; i < s_dispatch.size(); i++)
+        lua_callframescript(L, s_dispatch[i], "OnEvent", nargs);
+    s_dispatch.resize(begin);
+}
+
+static bool removeFilter(Frame* frame)
+{
+    auto removed = std::remove_if(s_filters.begin(), s_filters.end(), [frame](const CombatLogFilter& filter) {
+        return filter.frame == frame;
+    });
+    if (removed == s_filters.end()) return false;
+    s_filters.erase(removed, s_filters.end());
+    return true;
+}
+
+static void parseSubevents(CombatLogFilter& filter, const char* list)
+{
+    std::string names = list ? list : "";
+    for (size_t pos = 0; pos < names.size();) {
+        size_t end = names.find_first_of(", ", pos);
+        if (end == std::string::npos) end = names.size();
+        if (end > pos) {
+            std::string name = names.substr(pos, end - pos);
+            filter.subevents.emplace_back(hashString(name.c_str()), name);
+        }
+        pos = end + 1;
+    }
+}
+
+// guid is unit token or hex string, mask defaults to whole guid
+static void parseGuidArgs(lua_State* L, int idx, guid_t& guid, guid_t& mask)
+{
+    if (lua_type(L, idx) != LUA_TSTRING) {
+        guid = mask = 0;
+        return;
+    }
+    mask = lua_type(L, idx + 1) == LUA_TSTRING ? ObjectMgr::HexString2Guid(lua_tostring(L, idx + 1)) : ~(guid_t)0;
+    guid = ObjectMgr::String2Guid(lua_tostring(L, idx)) & mask;
+}
+
+static int lua_RegisterCombatLogEvent(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    const char* subevents = lua_type(L, 2) == LUA_TSTRING ? lua_tostring(L, 2) : NULL;
+
+    Frame* frame = lua_toframe_silent(L, 1);
+    if (s_eventId < 0) s_eventId = FrameScript::GetEventIdByName(COMBAT_LOG_EVENT_UNFILTERED);
+    if (!frame || s_eventId < 0) return 0;
+
+    // Unfiltered registration would deliver the event twice
+    lua_getfield(L, 1, "UnregisterEvent"); // func
+    lua_pushvalue(L, 1); // func, frame
+    lua_pushstring(L, COMBAT_LOG_EVENT_UNFILTERED); // func, frame, event
+    if (lua_pcall(L, 2, 0, 0)) lua_pop(L, 1);
+
+    removeFilter(frame);
+    CombatLogFilter& filter = s_filters.emplace_back();
+    filter.frame = frame;
+    filter.hits = 0;
+    parseSubevents(filter, subevents);
+    parseGuidArgs(L, 3, filter.sourceGuid, filter.sourceMask);
+    parseGuidArgs(L, 5, filter.destGuid, filter.destMask);
+
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int lua_UnregisterCombatLogEvent(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    Frame* frame = lua_toframe_silent(L, 1);
+    if (!frame || !removeFilter(frame)) return 0;
+
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int lua_GetCombatLogFilterStats(lua_State* L)
+{
+    lua_pushresulttable(L, 1, 0, s_filters.size()); // tbl
+    for (const CombatLogFilter& filter : s_filters) {
+        lua_pushframe(L, filter.frame); // tbl, frame
+        lua_pushnumber(L, filter.hits); // tbl, frame, hits
+        lua_rawset(L, -3); // tbl
+    }
+    return 1;
+}
+
+static int lua_openlibcombatlog(lua_State* L)
+{
+    // Frames of previous state are gone with it
+    s_filters.clear();
+    s_eventId = -1;
+
+    lua_pushcfunction(L, lua_GetCombatLogFilterStats);
+    lua_setglobal(L, "GetCombatLogFilterStats");
+    return 0;
+}
+
+void CombatLog::initialize()
+{
+    Hooks::FrameXML::registerLuaLib(lua_openlibcombatlog);
+    Hooks::FrameXML::registerFrameMethod("RegisterCombatLogEvent", lua_RegisterCombatLogEvent);
+    Hooks::FrameXML::registerFrameMethod("UnregisterCombatLogEvent", lua_UnregisterCombatLogEvent);
+    Hooks::FrameScript::registerOnFireEvent(onFireEvent);
+}
\ No newline at end of file
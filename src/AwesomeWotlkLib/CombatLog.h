@@ -0,0 +1,5 @@
+#pragma once
+
+namespace CombatLog {
+void initialize();
+}
\ No newline at end of file
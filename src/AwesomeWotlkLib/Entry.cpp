@@ -5,9 +5,20 @@
 #include "Hooks.h"
 #include "Inventory.h"
 #include "UnitAPI.h"
+#include "UnitEvents.h"
+#include "Timer.h"
+#include "LuaAllocator.h"
+#include "Profiler.h"
+#include "EventTrace.h"
+#include "CVarAPI.h"
+#include "FrameAPI.h"
+#include "LuaGC.h"
+#include "CombatLog.h"
+#include "Objects.h"
 #include <Windows.h>
 #include <Detours/detours.h>
 #include "VoiceChat.h"
+#include "StartupTrace.h"
 
 
 static int lua_debugbreak(lua_State* L)
@@ -17,6 +28,12 @@ static int lua_debugbreak(lua_State* L)
     return 0;
 }
 
+static void initializeModule(const char* name, void(*initialize)())
+{
+    StartupTrace::Scope scope(name);
+    initialize();
+}
+
 static int lua_openawesomewotlk(lua_State* L)
 {
     lua_pushnumber(L, 1.f);
@@ -42,17 +59,51 @@ static void OnAttach()
     *(DWORD*)0x00B6AF54 = 1; // TOSAccepted = 1
     *(DWORD*)0x00B6AF5C = 1; // EULAAccepted = 1
 
+    StartupTrace::initialize();
+
     // Initialize modules
     DetourTransactionBegin();
-    Hooks::initialize();
-    BugFixes::initialize();
-    CommandLine::initialize();
-    Inventory::initialize();
-    NamePlates::initialize();
-    Misc::initialize();
-    UnitAPI::initialize();
-    VoiceChat::initialize();
-    DetourTransactionCommit();
+    bool hooksReady;
+    {
+        StartupTrace::Scope scope("Hooks");
+        hooksReady = Hooks::initialize();
+    }
+    // Every module builds on hooks, library stays inactive without them
+    if (!hooksReady) {
+        DetourTransactionAbort();
+        return;
+    }
+    initializeModule("Objects", Objects::initialize); // first OnUpdate callback, takes snapshot for the rest
+    initializeModule("LuaAllocator", LuaAllocator::initialize);
+    initializeModule("BugFixes", BugFixes::initialize);
+    initializeModule("CommandLine", CommandLine::initialize);
+    initializeModule("Inventory", Inventory::initialize);
+    initializeModule("NamePlates", NamePlates::initialize);
+    initializeModule("Misc", Misc::initialize);
+    initializeModule("UnitAPI", UnitAPI::initialize);
+    initializeModule("UnitEvents", UnitEvents::initialize);
+    initializeModule("Timer", Timer::initialize);
+    initializeModule("Profiler", Profiler::initialize);
+    initializeModule("EventTrace", EventTrace::initialize);
+    initializeModule("CVarAPI", CVarAPI::initialize);
+    initializeModule("FrameAPI", FrameAPI::initialize);
+    initializeModule("LuaGC", LuaGC::initialize);
+    initializeModule("CombatLog", CombatLog::initialize);
+    initializeModule("VoiceChat", VoiceChat::initialize);
+    {
+        StartupTrace::Scope scope("DetourTransactionCommit");
+        DetourTransactionCommit();
+    }
+
+    // Expensive warm-up which doesn't touch game state goes to background, loader lock is held here
+    HANDLE warmUpThread = CreateThread(NULL, 0, [](LPVOID) -> DWORD {
+        VoiceChat::warmUp();
+        return 0;
+    }, NULL, 0, NULL);
+    if (warmUpThread)
+        CloseHandle(warmUpThread);
+    else
+        VoiceChat::warmUp();
 
     // Register base
     Hooks::FrameXML::registerLuaLib(lua_openawesomewotlk);
@@ -0,0 +1,16 @@
+#pragma once
+#include <type_traits>
+
+/*
+    Client enumerators take C callback and user data pointer: enumFunc(callback, udata), callback(value, udata)
+    returns nonzero to continue. Callable is passed through udata as is, so enumeration costs one indirect call
+    per value and no allocations. Doesn't depend on client, so it's also built on host by tools/EnumBench.
+*/
+template <typename T, typename Func>
+inline bool EnumCallback(int (*enumFunc)(int (*)(T, void*), void*), Func&& func)
+{
+    using Func_t = std::remove_reference_t<Func>;
+    return enumFunc([](T value, void* udata) -> int {
+        return (*(Func_t*)udata)(value) ? 1 : 0;
+    }, (void*)&func);
+}
\ No newline at end of file
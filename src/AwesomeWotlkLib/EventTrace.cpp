@@ -0,0 +1,294 @@
+#include "EventTrace.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#undef min
+#undef max
+
+/*
+    Opt-in recorder of every dispatched event. Main thread only fills fixed size records into
+    single-producer/single-consumer ring, background thread drains it to Logs\EventTrace.bin.
+    If writer can't keep up records are dropped and counted instead of stalling the frame.
+
+    File, little-endian, one session per file:
+        header: u32 magic "AWET", u32 version, u64 QPC frequency, u64 unix time
+        then tagged records until end of file:
+        name:   u8 1, u16 event id, u8 length, char[length]     (precedes first record of event)
+        event:  TraceRecord
+*/
+
+constexpr uint32_t TRACE_MAGIC = 'TEWA'; // "AWET"
+constexpr uint32_t TRACE_VERSION = 1;
+constexpr uint32_t TRACE_RING_SIZE = 1 << 16;
+constexpr uint32_t TRACE_MAX_DEPTH = 32;
+constexpr int TRACE_MAX_ARGS = 4;
+constexpr DWORD TRACE_FLUSH_INTERVAL = 100;
+
+enum : uint8_t {
+    TRACE_RECORD_NAME = 1,
+    TRACE_RECORD_EVENT = 2,
+};
+
+#pragma pack(push, 1)
+struct TraceRecord {
+    uint8_t type;
+    uint8_t nargs; // without event name
+    uint16_t eventId;
+    uint32_t frame;
+    uint32_t duration; // QPC ticks, nested events included
+    uint32_t argHash; // FNV-1a of first argument, 0 if it isn't string or number
+    uint16_t argTypes; // lua types of first 4 arguments, 4 bits each
+    uint8_t depth;
+    uint8_t reserved;
+};
+#pragma pack(pop)
+static_assert(sizeof(TraceRecord) == 20);
+
+struct TraceFrame {
+    LARGE_INTEGER start;
+    TraceRecord record;
+};
+
+static bool s_recording = false;
+static uint32_t s_frame = 0;
+static uint32_t s_depth = 0;
+static TraceFrame s_stack[TRACE_MAX_DEPTH];
+static std::vector<bool> s_namedEvents;
+static uint32_t s_recorded = 0;
+
+static TraceRecord s_ring[TRACE_RING_SIZE];
+static std::atomic<uint32_t> s_ringHead = 0; // written by main thread
+static std::atomic<uint32_t> s_ringTail = 0; // written by writer thread
+static std::atomic<uint32_t> s_dropped = 0;
+
+static std::mutex s_namesMutex;
+static std::vector<std::pair<uint16_t, std::string>> s_pendingNames;
+static std::atomic<bool> s_writerStop = false;
+static HANDLE s_writer = NULL; // not std::thread, which terminates process if left joinable at exit
+static FILE* s_file = NULL;
+
+static uint32_t hashBytes(const void* data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ ((const uint8_t*)data)[i]) * 16777619u;
+    return hash;
+}
+
+static uint32_t hashArgument(lua_State* L, int idx, int type)
+{
+    if (type == LUA_TSTRING) {
+        size_t len;
+        const char* str = lua_tolstring(L, idx, &len);
+        return hashBytes(str, len);
+    }
+    if (type == LUA_TNUMBER) {
+        lua_Number value = lua_tonumber(L, idx);
+        return hashBytes(&value, sizeof(value));
+    }
+    return 0;
+}
+
+static void pushRecord(const TraceRecord& record)
+{
+    uint32_t head = s_ringHead.load(std::memory_order_relaxed);
+    if (head - s_ringTail.load(std::memory_order_acquire) >= TRACE_RING_SIZE) {
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    s_ring[head % TRACE_RING_SIZE] = record;
+    s_ringHead.store(head + 1, std::memory_order_release);
+    s_recorded++;
+}
+
+static void onEventTrace(int eventId, lua_State* L, int nargs, bool begin)
+{
+    if (!s_recording) return;
+
+    if (begin) {
+        if (s_depth++ >= TRACE_MAX_DEPTH) return;
+        TraceFrame& frame = s_stack[s_depth - 1];
+        TraceRecord& record = frame.record;
+        record = { TRACE_RECORD_EVENT, (uint8_t)std::max(nargs - 1, 0), (uint16_t)eventId, s_frame };
+        record.depth = s_depth - 1;
+        for (int i = 1; i < nargs && i <= TRACE_MAX_ARGS; i++) {
+            int type = lua_type(L, -nargs + i);
+            record.argTypes |= (type & 0xF) << ((i - 1) * 4);
+            if (i == 1) record.argHash = hashArgument(L, -nargs + i, type);
+        }
+
+        if ((size_t)eventId >= s_namedEvents.size()) s_namedEvents.resize(eventId + 1);
+        if (!s_namedEvents[eventId]) {
+            s_namedEvents[eventId] = true;
+            const char* name = FrameScript::GetEventNameById(eventId);
+            std::lock_guard lock(s_namesMutex);
+            s_pendingNames.emplace_back(eventId, name ? name : "");
+        }
+        QueryPerformanceCounter(&frame.start);
+        return;
+    }
+
+    if (!s_depth || s_depth-- > TRACE_MAX_DEPTH) return;
+    TraceFrame& frame = s_stack[s_depth];
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    frame.record.duration = (uint32_t)std::min<LONGLONG>(now.QuadPart - frame.start.QuadPart, UINT32_MAX);
+    pushRecord(frame.record);
+}
+
+static void onUpdateCallback()
+{
+    s_frame++;
+}
+
+// Writer thread
+static void flushRing()
+{
+    // Names are queued before records using them, so take head first
+    uint32_t head = s_ringHead.load(std::memory_order_acquire);
+    uint32_t tail = s_ringTail.load(std::memory_order_relaxed);
+
+    std::vector<std::pair<uint16_t, std::string>> names;
+    {
+        std::lock_guard lock(s_namesMutex);
+        names.swap(s_pendingNames);
+    }
+    for (auto& [id, name] : names) {
+        uint8_t type = TRACE_RECORD_NAME;
+        uint8_t len = (uint8_t)std::min<size_t>(name.size(), UINT8_MAX);
+        fwrite(&type, 1, 1, s_file);
+        fwrite(&id, 2, 1, s_file);
+        fwrite(&len, 1, 1, s_file);
+        fwrite(name.data(), 1, len, s_file);
+    }
+
+    while (tail != head) {
+        uint32_t begin = tail % TRACE_RING_SIZE;
+        uint32_t count = std::min(head - tail, TRACE_RING_SIZE - begin);
+        fwrite(&s_ring[begin], sizeof(TraceRecord), count, s_file);
+        tail += count;
+        s_ringTail.store(tail, std::memory_order_release);
+    }
+    fflush(s_file);
+}
+
+static DWORD WINAPI writerMain(LPVOID)
+{
+    while (!s_writerStop.load(std::memory_order_acquire)) {
+        Sleep(TRACE_FLUSH_INTERVAL);
+        flushRing();
+    }
+    flushRing();
+    return 0;
+}
+
+static bool startRecording()
+{
+    CreateDirectoryA("Logs", NULL);
+    if (fopen_s(&s_file, "Logs\\EventTrace.bin", "wb") || !s_file)
+        return false;
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    uint32_t header[2] = { TRACE_MAGIC, TRACE_VERSION };
+    uint64_t frequency = freq.QuadPart, now = (uint64_t)time(NULL);
+    fwrite(header, sizeof(header), 1, s_file);
+    fwrite(&frequency, sizeof(frequency), 1, s_file);
+    fwrite(&now, sizeof(now), 1, s_file);
+
+    s_namedEvents.clear();
+    s_pendingNames.clear();
+    s_ringHead = s_ringTail = 0;
+    s_dropped = 0;
+    s_recorded = 0;
+    s_depth = 0;
+    s_writerStop = false;
+    s_writer = CreateThread(NULL, 0, writerMain, NULL, 0, NULL);
+    if (!s_writer) {
+        fclose(s_file);
+        s_file = NULL;
+        return false;
+    }
+    s_recording = true;
+    return true;
+}
+
+static void stopRecording()
+{
+    s_recording = false;
+    s_writerStop = true;
+    if (s_writer) {
+        WaitForSingleObject(s_writer, INFINITE);
+        CloseHandle(s_writer);
+        s_writer = NULL;
+    }
+    if (s_file) {
+        fclose(s_file);
+        s_file = NULL;
+    }
+}
+
+static int C_EventTrace_Start(lua_State* L)
+{
+    if (!s_recording && !startRecording()) return 0;
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int C_EventTrace_Stop(lua_State* L)
+{
+    if (s_recording) stopRecording();
+    return 0;
+}
+
+static int C_EventTrace_IsRecording(lua_State* L)
+{
+    if (!s_recording) return 0;
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int C_EventTrace_GetStats(lua_State* L)
+{
+    lua_pushnumber(L, s_recorded);
+    lua_pushnumber(L, s_dropped.load(std::memory_order_relaxed));
+    return 2;
+}
+
+static int lua_openlibeventtrace(lua_State* L)
+{
+    luaL_Reg methods[] = {
+        {"Start", C_EventTrace_Start},
+        {"Stop", C_EventTrace_Stop},
+        {"IsRecording", C_EventTrace_IsRecording},
+        {"GetStats", C_EventTrace_GetStats},
+    };
+
+    lua_createtable(L, 0, std::size(methods));
+    for (size_t i = 0; i < std::size(methods); i++) {
+        lua_pushcfunction(L, methods[i].func);
+        lua_setfield(L, -2, methods[i].name);
+    }
+    lua_setglobal(L, "C_EventTrace");
+    return 0;
+}
+
+void EventTrace::shutdown()
+{
+    if (s_recording) stopRecording();
+}
+
+void EventTrace::initialize()
+{
+    Hooks::FrameXML::registerLuaLib(lua_openlibeventtrace);
+    Hooks::FrameScript::registerEventTracer(onEventTrace);
+    Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
+}
\ No newline at end of file
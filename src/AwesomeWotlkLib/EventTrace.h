@@ -0,0 +1,7 @@
+#pragma once
+
+namespace EventTrace {
+void initialize();
+// Flushes and closes running recording
+void shutdown();
+}
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "FrameAPI.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+#define UPDATE_SCRIPTS_KEY "AwesomeWotlkUpdateScripts"
+
+/*
+    Throttled OnUpdate: script is taken from the frame (client no longer calls it every frame) and kept
+    in registry with its hooks, native loop accumulates elapsed time and calls them once interval passes.
+    Visibility is checked only when interval passes. GetScript, SetScript and HookScript of OnUpdate are
+    redirected to the stored handlers while frame is throttled, everything goes back to the frame when it ends.
+*/
+struct ThrottledFrame {
+    Frame* frame;
+    double interval;
+    double elapsed;
+};
+
+static std::vector<ThrottledFrame> s_throttled;
+static LARGE_INTEGER s_frequency;
+static LARGE_INTEGER s_lastUpdate;
+
+// Frames live until UI is reloaded, so once checked pointer stays valid until the set is cleared on lib open
+static std::unordered_set<Frame*> s_checkedFrames;
+
+// lua_toframe raises lua error for non-frame objects, it's called only first time frame is seen
+static Frame* lua_tocheckedframe(lua_State* L, int idx)
+{
+    if (!lua_istable(L, idx)) return NULL;
+    Frame* frame = lua_toframe_silent(L, idx);
+    if (!frame) return NULL;
+    if (s_checkedFrames.find(frame) == s_checkedFrames.end()) {
+        if (lua_toframe(L, idx) != frame) return NULL;
+        s_checkedFrames.insert(frame);
+    }
+    return frame;
+}
+
+static bool lua_isskipped(lua_State* L, int idx) { return lua_type(L, idx) <= LUA_TBOOLEAN; }
+
+// method, args at top. Errors go to error handler at eh, as for scripts called by client
+static bool callMethod(lua_State* L, int nargs, int nresults, int eh)
+{
+    if (lua_pcall(L, nargs, nresults, eh)) {
+        lua_pop(L, 1);
+        return false;
+    }
+    return true;
+}
+
+// Result of global/method called with topmost nargs values and function below them, errors count as false
+static bool callPredicate(lua_State* L, int nargs)
+{
+    if (lua_pcall(L, nargs, 1, 0)) {
+        lua_pop(L, 1);
+        return false;
+    }
+    bool result = lua_type(L, -1) > LUA_TBOOLEAN || (lua_isboolean(L, -1) && lua_toboolean(L, -1));
+    lua_pop(L, 1);
+    return result;
+}
+
+/*
+    C_Frame.SetFrameLevels({ frame, level, ... }[, count])
+    Levels are set natively. In combat lockdown protected frames go through their SetFrameLevel method,
+    so the client blocks insecure callers as it does for the method itself
+*/
+static int C_Frame_SetFrameLevels(lua_State* L)
+{
+    constexpr int RECORD_SIZE = 2;
+    luaL_checktype(L, 1, LUA_TTABLE);
+    // Skipped fields may leave holes, so length operator isn't reliable then
+    int count = lua_isnoneornil(L, 2) ? (lua_objlen(L, 1) + RECORD_SIZE - 1) / RECORD_SIZE : (int)luaL_checknumber(L, 2);
+    lua_settop(L, 1);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, GetLuaRefErrorHandler()); // batch, eh
+    constexpr int eh = 2;
+
+    lua_getglobal(L, "InCombatLockdown"); // batch, eh, InCombatLockdown
+    bool lockdown = callPredicate(L, 0);
+
+    int applied = 0;
+    for (int i = 0; i < count; i++) {
+        int base = lua_gettop(L);
+        lua_rawgeti(L, 1, i * RECORD_SIZE + 1); // frame
+        lua_rawgeti(L, 1, i * RECORD_SIZE + 2); // frame, level
+        int idx = base + 1;
+
+        Frame* frame = lua_tocheckedframe(L, idx);
+        if (!frame || lua_isskipped(L, idx + 1)) {
+            lua_settop(L, base);
+            continue;
+        }
+
+        bool secured = false;
+        if (lockdown) {
+            lua_getfield(L, idx, "IsProtected"); // frame, level, IsProtected
+            lua_pushvalue(L, idx); // frame, level, IsProtected, frame
+            secured = callPredicate(L, 1);
+        }
+
+        if (secured) {
+            lua_getfield(L, idx, "SetFrameLevel"); // frame, level, SetFrameLevel
+            lua_pushvalue(L, idx); // frame, level, SetFrameLevel, frame
+            lua_pushvalue(L, idx + 1); // frame, level, SetFrameLevel, frame, level
+            if (callMethod(L, 2, 0, eh)) applied++;
+        } else {
+            CFrame::SetFrameLevel(frame, (int)lua_tonumber(L, idx + 1), 1);
+            applied++;
+        }
+        lua_settop(L, base);
+    }
+
+    lua_pushnumber(L, applied);
+    return 1;
+}
+
+static std::vector<ThrottledFrame>::iterator findThrottled(Frame* frame)
+{
+    return std::find_if(s_throttled.begin(), s_throttled.end(), [frame](const ThrottledFrame& entry) { return entry.frame == frame; });
+}
+
+// Calls method of the frame at idx with topmost nargs values, errors go to error handler at eh
+static bool callFrameMethod(lua_State* L, int idx, const char* method, int nargs, int nresults, int eh)
+{
+    lua_getfield(L, idx, method); // args, method
+    lua_insert(L, -(nargs + 1)); // method, args
+    lua_pushvalue(L, idx); // method, args, frame
+    lua_insert(L, -(nargs + 1)); // method, frame, args
+    return callMethod(L, nargs + 1, nresults, eh);
+}
+
+// Handlers of throttled frame at idx: { script, hooks... } at top, table is empty if frame has no script
+static void pushUpdateHandlers(lua_State* L, int idx)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, UPDATE_SCRIPTS_KEY); // scripts
+    lua_pushvalue(L, idx); // scripts, frame
+    lua_rawget(L, -2); // scripts, handlers
+    lua_insert(L, -2); // handlers, scripts
+    lua_pop(L, 1);
+}
+
+// Moves OnUpdate script of the frame at idx into registry, frame must not be throttled yet
+static void takeUpdateScript(lua_State* L, int idx)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, GetLuaRefErrorHandler()); // eh
+    int eh = lua_gettop(L);
+    lua_getfield(L, LUA_REGISTRYINDEX, UPDATE_SCRIPTS_KEY); // eh, scripts
+    lua_pushvalue(L, idx); // eh, scripts, frame
+    lua_createtable(L, 1, 0); // eh, scripts, frame, handlers
+    lua_pushstring(L, "OnUpdate"); // ..., handlers, "OnUpdate"
+    if (callFrameMethod(L, idx, "GetScript", 1, 1, eh)) { // ..., handlers, script
+        if (lua_isfunction(L, -1)) lua_rawseti(L, -2, 1); // eh, scripts, frame, handlers
+        else lua_pop(L, 1);
+    }
+    lua_rawset(L, -3); // eh, scripts
+    lua_pop(L, 1);
+
+    lua_pushstring(L, "OnUpdate"); // eh, "OnUpdate"
+    lua_pushnil(L); // eh, "OnUpdate", nil
+    callFrameMethod(L, idx, "SetScript", 2, 0, eh);
+    lua_pop(L, 1);
+}
+
+// Gives stored script and hooks back to the frame at idx, frame must be already removed from throttled
+static void restoreUpdateScript(lua_State* L, int idx)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, GetLuaRefErrorHandler()); // eh
+    int eh = lua_gettop(L);
+    pushUpdateHandlers(L, idx); // eh, handlers
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 2);
+        return;
+    }
+    int handlers = lua_gettop(L);
+    int count = lua_objlen(L, handlers);
+    for (int i = 1; i <= count; i++) {
+        lua_pushstring(L, "OnUpdate"); // handlers, "OnUpdate"
+        lua_rawgeti(L, handlers, i); // handlers, "OnUpdate", handler
+        if (lua_isfunction(L, -1)) callFrameMethod(L, idx, i == 1 ? "SetScript" : "HookScript", 2, 0, eh);
+        else lua_pop(L, 2);
+    }
+    lua_pop(L, 2);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, UPDATE_SCRIPTS_KEY); // scripts
+    lua_pushvalue(L, idx); // scripts, frame
+    lua_pushnil(L); // scripts, frame, nil
+    lua_rawset(L, -3); // scripts
+    lua_pop(L, 1);
+}
+
+static bool isFrameVisible(lua_State* L, int idx)
+{
+    lua_getfield(L, idx, "IsVisible"); // IsVisible
+    lua_pushvalue(L, idx); // IsVisible, frame
+    if (lua_pcall(L, 1, 1, 0)) {
+        lua_pop(L, 1);
+        return false;
+    }
+    bool visible = lua_type(L, -1) > LUA_TBOOLEAN || (lua_isboolean(L, -1) && lua_toboolean(L, -1));
+    lua_pop(L, 1);
+    return visible;
+}
+
+// Frame:SetUpdateInterval(seconds), 0 or nil gives script back to the client
+static int lua_SetUpdateInterval(lua_State* L)
+{
+    Frame* frame = lua_tocheckedframe(L, 1);
+    double interval = lua_isnoneornil(L, 2) ? 0.0 : luaL_checknumber(L, 2);
+    if (!frame) return 0;
+    lua_settop(L, 1);
+
+    auto it = findThrottled(frame);
+    if (interval > 0) {
+        if (it == s_throttled.end()) {
+            takeUpdateScript(L, 1);
+            s_throttled.push_back({ frame, interval, 0.0 });
+        } else {
+            it->interval = interval;
+        }
+        lua_pushnumber(L, 1);
+        return 1;
+    }
+
+    if (it == s_throttled.end()) return 0;
+    s_throttled.erase(it);
+    restoreUpdateScript(L, 1);
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+// Overrides of frame methods, args: frame, scriptType[, handler]. Handled only for OnUpdate of throttled frames
+static bool isThrottledUpdate(lua_State* L)
+{
+    if (!lua_istable(L, 1) || lua_type(L, 2) != LUA_TSTRING || strcmp(lua_tostring(L, 2), "OnUpdate") != 0)
+        return false;
+    Frame* frame = lua_toframe_silent(L, 1);
+    return frame && findThrottled(frame) != s_throttled.end();
+}
+
+static int lua_GetScriptOverride(lua_State* L)
+{
+    if (!isThrottledUpdate(L)) return 0;
+    pushUpdateHandlers(L, 1); // handlers
+    if (!lua_istable(L, -1)) return 0;
+    lua_pushnumber(L, 1); // handlers, true
+    lua_insert(L, -2); // true, handlers
+    lua_rawgeti(L, -1, 1); // true, handlers, script
+    lua_insert(L, -2); // true, script, handlers
+    lua_pop(L, 1);
+    if (!lua_isfunction(L, -1)) {
+        lua_pop(L, 1);
+        lua_pushnil(L);
+    }
+    return 2;
+}
+
+static int lua_SetScriptOverride(lua_State* L)
+{
+    if (!isThrottledUpdate(L)) return 0;
+    if (!lua_isnoneornil(L, 3)) luaL_checktype(L, 3, LUA_TFUNCTION);
+    // Hooks are dropped with the script they were hooking
+    lua_getfield(L, LUA_REGISTRYINDEX, UPDATE_SCRIPTS_KEY); // scripts
+    lua_pushvalue(L, 1); // scripts, frame
+    lua_createtable(L, 1, 0); // scripts, frame, handlers
+    if (lua_isfunction(L, 3)) {
+        lua_pushvalue(L, 3);
+        lua_rawseti(L, -2, 1);
+    }
+    lua_rawset(L, -3); // scripts
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int lua_HookScriptOverride(lua_State* L)
+{
+    // Original method raises error for wrong arguments
+    if (!isThrottledUpdate(L) || !lua_isfunction(L, 3)) return 0;
+    pushUpdateHandlers(L, 1); // handlers
+    if (!lua_istable(L, -1)) return 0;
+    lua_rawgeti(L, -1, 1); // handlers, script
+    // Hook of frame without script becomes the script
+    int slot = lua_isfunction(L, -1) ? lua_objlen(L, -2) + 1 : 1;
+    lua_pop(L, 1);
+    lua_pushvalue(L, 3); // handlers, hook
+    lua_rawseti(L, -2, slot); // handlers
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int lua_GetUpdateInterval(lua_State* L)
+{
+    Frame* frame = lua_tocheckedframe(L, 1);
+    auto it = findThrottled(frame);
+    if (!frame || it == s_throttled.end()) return 0;
+    lua_pushnumber(L, it->interval);
+    return 1;
+}
+
+static void onUpdateCallback()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    double delta = (double)(now.QuadPart - s_lastUpdate.QuadPart) / s_frequency.QuadPart;
+    s_lastUpdate = now;
+    if (s_throttled.empty()) return;
+
+    // Scripts may change intervals while being called
+    static std::vector<std::pair<Frame*, double>> s_due;
+    for (ThrottledFrame& entry : s_throttled) {
+        entry.elapsed += delta;
+        if (entry.elapsed >= entry.interval) {
+            s_due.push_back({ entry.frame, entry.elapsed });
+            entry.elapsed = 0.0;
+        }
+    }
+    if (s_due.empty()) return;
+
+    lua_State* L = GetLuaState();
+    int top = lua_gettop(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, GetLuaRefErrorHandler()); // eh
+    lua_getglobal(L, "this"); // eh, this
+    lua_getglobal(L, "arg1"); // eh, this, arg1
+    int base = lua_gettop(L);
+    for (auto& [frame, elapsed] : s_due) {
+        lua_pushframe(L, frame); // frame
+        int idx = lua_gettop(L);
+        // Hidden frames don't get OnUpdate, time spent hidden isn't passed either
+        if (!isFrameVisible(L, idx)) {
+            lua_settop(L, base);
+            continue;
+        }
+
+        pushUpdateHandlers(L, idx); // frame, handlers
+        if (lua_istable(L, -1)) {
+            int handlers = lua_gettop(L);
+            // Legacy globals the client sets around every script call
+            lua_pushvalue(L, idx);
+            lua_setglobal(L, "this");
+            lua_pushnumber(L, elapsed);
+            lua_setglobal(L, "arg1");
+            // Length is taken on each step, hooks added by the handlers run too
+            for (int i = 1; i <= lua_objlen(L, handlers); i++) {
+                lua_rawgeti(L, handlers, i); // frame, handlers, handler
+                if (!lua_isfunction(L, -1)) {
+                    lua_pop(L, 1);
+                    continue;
+                }
+                lua_pushvalue(L, idx); // frame, handlers, handler, frame
+                lua_pushnumber(L, elapsed); // frame, handlers, handler, frame, elapsed
+                lua_pcall(L, 2, 0, top + 1);
+            }
+        }
+        lua_settop(L, base);
+    }
+    lua_pushvalue(L, top + 2);
+    lua_setglobal(L, "this");
+    lua_pushvalue(L, top + 3);
+    lua_setglobal(L, "arg1");
+    lua_settop(L, top);
+    s_due.clear();
+}
+
+static int lua_openlibframe(lua_State* L)
+{
+    // Scripts and frames of previous state are gone with it, addresses may be reused by new frames
+    s_throttled.clear();
+    s_checkedFrames.clear();
+    lua_createtable(L, 0, 0);
+    lua_setfield(L, LUA_REGISTRYINDEX, UPDATE_SCRIPTS_KEY);
+
+    luaL_Reg methods[] = {
+        {"SetFrameLevels", C_Frame_SetFrameLevels},
+    };
+
+    lua_createtable(L, 0, std::size(methods));
+    for (size_t i = 0; i < std::size(methods); i++) {
+        lua_pushcfunction(L, methods[i].func);
+        lua_setfield(L, -2, methods[i].name);
+    }
+    lua_setglobal(L, "C_Frame");
+    return 0;
+}
+
+void FrameAPI::initialize()
+{
+    QueryPerformanceFrequency(&s_frequency);
+    QueryPerformanceCounter(&s_lastUpdate);
+
+    Hooks::FrameXML::registerLuaLib(lua_openlibframe);
+    Hooks::FrameXML::registerFrameMethod("SetUpdateInterval", lua_SetUpdateInterval);
+    Hooks::FrameXML::registerFrameMethod("GetUpdateInterval", lua_GetUpdateInterval);
+    Hooks::FrameXML::registerFrameMethodOverride("GetScript", lua_GetScriptOverride);
+    Hooks::FrameXML::registerFrameMethodOverride("SetScript", lua_SetScriptOverride);
+    Hooks::FrameXML::registerFrameMethodOverride("HookScript", lua_HookScriptOverride);
+    Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
+}
\ No newline at end of file
@@ -1,8 +1,13 @@
 #pragma once
+#include "EnumCallback.h"
 #include <Windows.h>
 #include <cstdint>
 #include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <functional>
+#include <type_traits>
 
 /*
     Game client types/functions/bindings and other import
@@ -180,6 +185,7 @@ struct Player {
 
 enum ObjectFlags : uint32_t {
     ObjectFlags_Unit = 0x8,
+    ObjectFlags_Player = 0x10,
 };
 
 // Base
@@ -225,29 +231,36 @@ inline uint32_t __stdcall hash(const char* str) { return ((decltype(&hash))0x007
 
 inline bool IsInWorld() { return *(char*)0x00BD0792; }
 
+// Unit
+enum UnitReaction {
+    UnitReaction_Hated,
+    UnitReaction_Hostile,
+    UnitReaction_Unfriendly,
+    UnitReaction_Neutral,
+    UnitReaction_Friendly,
+};
+
+namespace CGUnit {
+// Zero based, UnitReaction() of lua adds one
+inline int GetReaction(Unit* self, Unit* other) { return ((int(__thiscall*)(Unit*, Unit*))0x007251C0)(self, other); }
+}
+
 // ObjectMgr
 namespace ObjectMgr {
 
 inline int EnumObjects_internal(int(*func)(guid_t, void*), void* udata) { return ((decltype(&EnumObjects_internal))0x004D4B30)(func, udata); }
 
-using EnumVisibleObject_func_t = std::function<bool(guid_t guid)>;
-inline bool EnumObjects(EnumVisibleObject_func_t func)
-{
-    struct Wrapper {
-        static int foo(guid_t guid, void* udata)
-        {
-            EnumVisibleObject_func_t& func = *(EnumVisibleObject_func_t*)udata;
-            return func(guid) ? 1 : 0;
-        }
-    };
-    return EnumObjects_internal(&Wrapper::foo, (void*)&func);
-};
+// func(guid) -> continue
+template <typename Func>
+inline bool EnumObjects(Func&& func) { return EnumCallback(EnumObjects_internal, std::forward<Func>(func)); }
 
 inline Player* GetPlayer() { return ((decltype(&GetPlayer))0x004038F0)(); }
 inline Object* Get(guid_t guid, ObjectFlags flags) { return ((Object*(*)(guid_t, ObjectFlags))0x004D4DB0)(guid, flags); }
 inline void Guid2HexString(guid_t guid, char* buf) { return ((decltype(&Guid2HexString))0x0074D0D0)(guid, buf); }
 inline guid_t HexString2Guid(const char* str) { return ((decltype(&HexString2Guid))0x0074D120)(str); }
 inline guid_t GetGuidByUnitID(const char* unitId) { return ((decltype(&GetGuidByUnitID))0x0060C1C0)(unitId); }
+// Unit tokens pointing to guid, buffer is static and holds up to 8 tokens of 32 chars
+inline char** GetKeywordsByGuid(guid_t* guid, size_t* size) { return ((decltype(&GetKeywordsByGuid))0x0060BB70)(guid, size); }
 
 inline guid_t String2Guid(const char* str)
 {
@@ -260,6 +273,37 @@ inline guid_t String2Guid(const char* str)
 
 inline Object* Get(const char* str, ObjectFlags flags) { return Get(String2Guid(str), flags); }
 
+// Typed enumerators, objects of other types are skipped before callable is called: func(guid, object) -> continue
+template <typename Func>
+inline bool EnumUnits(Func&& func)
+{
+    return EnumObjects([&func](guid_t guid) -> bool {
+        Unit* unit = (Unit*)Get(guid, ObjectFlags_Unit);
+        return unit ? func(guid, unit) : true;
+    });
+}
+
+template <typename Func>
+inline bool EnumPlayers(Func&& func)
+{
+    return EnumObjects([&func](guid_t guid) -> bool {
+        Player* player = (Player*)Get(guid, ObjectFlags_Player);
+        return player ? func(guid, player) : true;
+    });
+}
+
+// Units hostile or unfriendly to active player
+template <typename Func>
+inline bool EnumHostileUnits(Func&& func)
+{
+    Player* player = GetPlayer();
+    if (!player) return true;
+    Unit* self = player->ToUnit();
+    return EnumUnits([&func, self](guid_t guid, Unit* unit) -> bool {
+        return CGUnit::GetReaction(self, unit) <= UnitReaction_Unfriendly ? func(guid, unit) : true;
+    });
+}
+
 inline int UnitRightClickByGuid(guid_t guid) { return ((decltype(&UnitRightClickByGuid))0x005277B0)(guid); }
 inline int UnitLeftClickByGuid(guid_t guid) { return ((decltype(&UnitLeftClickByGuid))0x005274F0)(guid); }
 inline void SetMouseoverByGuid(guid_t guid, guid_t prev) { return ((decltype(&SetMouseoverByGuid))0x0051F790)(guid, prev); }
@@ -339,6 +383,7 @@ inline Event* __fastcall FindEvent(UnkContainer* This, void* edx, const char* ev
 inline EventList* GetEventList() { return (EventList*)0x00D3F7D0; }
 inline void FireEvent_inner(int eventId, lua_State* L, int nargs) { return ((decltype(&FireEvent_inner))0x0081AA00)(eventId, L, nargs); };
 inline void vFireEvent(int eventId, const char* format, va_list args) { return ((decltype(&vFireEvent))0x0081AC90)(eventId, format, args); }
+inline void Execute(const char* code, const char* name, int a3) { return ((decltype(&Execute))0x00819210)(code, name, a3); }
 
 inline int GetEventIdByName(const char* eventName)
 {
@@ -501,6 +546,15 @@ struct __declspec(novtable) XMLObject {
 #define LUA_TUSERDATA		7
 #define LUA_TTHREAD		8
 
+#define LUA_GCSTOP		0
+#define LUA_GCRESTART		1
+#define LUA_GCCOLLECT		2
+#define LUA_GCCOUNT		3
+#define LUA_GCCOUNTB		4
+#define LUA_GCSTEP		5
+#define LUA_GCSETPAUSE		6
+#define LUA_GCSETSTEPMUL	7
+
 #define LUA_REGISTRYINDEX	(-10000)
 #define LUA_ENVIRONINDEX	(-10001)
 #define LUA_GLOBALSINDEX	(-10002)
@@ -508,6 +562,7 @@ struct __declspec(novtable) XMLObject {
 
 
 using lua_CFunction = int(*)(lua_State*);
+using lua_Alloc = void*(*)(void* ud, void* ptr, size_t osize, size_t nsize);
 typedef struct luaL_Reg {
     const char* name;
     lua_CFunction func;
@@ -516,12 +571,16 @@ typedef struct luaL_Reg {
 inline void luaL_checktype(lua_State* L, int idx, int t) { return ((decltype(&luaL_checktype))0x0084F960)(L, idx, t); }
 inline const char* luaL_checklstring(lua_State* L, int idx, size_t* len) { return ((decltype(&luaL_checklstring))0x0084F9F0)(L, idx, len); }
 inline lua_Number luaL_checknumber(lua_State* L, int idx) { return ((decltype(&luaL_checknumber))0x84FAB0)(L, idx); }
+inline const char* lua_tolstring(lua_State* L, int idx, size_t* len) { return ((decltype(&lua_tolstring))0x0084E0E0)(L, idx, len); }
+inline lua_Number lua_tonumber(lua_State* L, int idx) { return ((decltype(&lua_tonumber))0x0084E030)(L, idx); }
+inline int lua_toboolean(lua_State* L, int idx) { return ((decltype(&lua_toboolean))0x0084E0B0)(L, idx); }
 inline void* lua_touserdata(lua_State* L, int idx) { return ((decltype(&lua_touserdata))0x0084E1C0)(L, idx); }
 inline void lua_pushstring(lua_State* L, const char* str) { return ((decltype(&lua_pushstring))0x0084E350)(L, str); }
 inline void lua_pushvalue(lua_State* L, int idx) { return ((decltype(&lua_pushvalue))0x0084DE50)(L, idx); }
 inline void lua_pushnumber(lua_State* L, lua_Number v) { return ((decltype(&lua_pushnumber))0x0084E2A0)(L, v); }
 inline void lua_pushcclosure(lua_State* L, lua_CFunction func, int c) { return ((decltype(&lua_pushcclosure))0x0084E400)(L, func, c); }
 inline void lua_pushnil(lua_State* L) { return ((decltype(&lua_pushnil))0x0084E280)(L); }
+inline void lua_pushlightuserdata(lua_State* L, void* p) { return ((decltype(&lua_pushlightuserdata))0x0084E500)(L, p); }
 inline void lua_rawseti(lua_State* L, int idx, int pos) { return ((decltype(&lua_rawseti))0x0084EA00)(L, idx, pos); }
 inline void lua_rawgeti(lua_State* L, int idx, int pos) { return ((decltype(&lua_rawgeti))0x0084E670)(L, idx, pos); }
 inline void lua_rawset(lua_State* L, int idx) { return ((decltype(&lua_rawset))0x0084E970)(L, idx); }
@@ -535,11 +594,132 @@ inline void lua_settop(lua_State* L, int idx) { return ((decltype(&lua_settop))0
 inline int lua_objlen(lua_State* L, int idx) { return ((decltype(&lua_objlen))0x0084E150)(L, idx); }
 inline int lua_type(lua_State* L, int idx) { return ((decltype(&lua_type))0x0084DEB0)(L, idx); }
 inline int lua_pcall(lua_State* L, int argn, int retn, int eh) { return ((decltype(&lua_pcall))0x0084EC50)(L, argn, retn, eh); }
+inline int lua_gc(lua_State* L, int what, int data) { return ((decltype(&lua_gc))0x0084ED50)(L, what, data); }
 inline int lua_GetParamValue(lua_State* L, int idx, int default_) { return ((decltype(&lua_GetParamValue))0x00815500)(L, idx, default_); }
 inline void lua_createtable(lua_State* L, int narr, int nrec) { return ((decltype(&lua_createtable))0x0084E6E0)(L, narr, nrec); }
 inline void* lua_newuserdata(lua_State* L, size_t size) { return ((decltype(&lua_newuserdata))0x0084F0F0)(L, size); }
 inline int lua_setmetatable(lua_State* L, int idx) { return ((decltype(&lua_setmetatable))0x0084EA90)(L, idx); }
 
+// Lua 5.1 internals, only leading fields that are used
+struct lua_TValue {
+    union {
+        void* gc;
+        lua_Number n;
+    } value;
+    int tt;
+};
+static_assert(sizeof(lua_TValue) == 0x10);
+
+struct lua_TString {
+    void* next;
+    uint8_t tt;
+    uint8_t marked;
+    uint8_t reserved;
+    uint32_t hash;
+    size_t len;
+
+    inline const char* str() const { return (const char*)(this + 1); }
+};
+static_assert(sizeof(lua_TString) == 0x10);
+
+struct lua_Proto {
+    void* next;
+    uint8_t tt;
+    uint8_t marked;
+    lua_TValue* k;
+    uint32_t* code;
+    lua_Proto** p;
+    int* lineinfo;
+    void* locvars;
+    lua_TString** upvalues;
+    lua_TString* source;
+};
+static_assert(offsetof(lua_Proto, source) == 0x20);
+
+struct lua_LClosure {
+    void* next;
+    uint8_t tt;
+    uint8_t marked;
+    uint8_t isC;
+    uint8_t nupvalues;
+    void* gclist;
+    void* env;
+    lua_Proto* p;
+};
+static_assert(offsetof(lua_LClosure, p) == 0x10);
+
+struct lua_GlobalStateHead {
+    void** strtHash;
+    uint32_t strtNuse;
+    int strtSize;
+    lua_Alloc frealloc;
+    void* ud;
+};
+
+struct lua_CallInfo {
+    lua_TValue* base;
+    lua_TValue* func;
+    lua_TValue* top;
+    const uint32_t* savedpc;
+    int nresults;
+    int tailcalls;
+};
+static_assert(sizeof(lua_CallInfo) == 0x18);
+
+struct lua_StateHead {
+    void* next;
+    uint8_t tt;
+    uint8_t marked;
+    uint8_t status;
+    lua_TValue* top;
+    lua_TValue* base;
+    lua_GlobalStateHead* l_G;
+    lua_CallInfo* ci;
+    const uint32_t* savedpc;
+    lua_TValue* stack_last;
+    lua_TValue* stack;
+    lua_CallInfo* end_ci;
+    lua_CallInfo* base_ci;
+};
+static_assert(offsetof(lua_StateHead, l_G) == 0x10);
+static_assert(offsetof(lua_StateHead, base_ci) == 0x28);
+
+// Source of lua function at idx, e.g. "@Interface\AddOns\Foo\Foo.lua", NULL for C functions and non-functions
+inline lua_TString* lua_tochunk(lua_State* L, int idx)
+{
+    lua_StateHead* state = (lua_StateHead*)L;
+    lua_TValue* o = idx > 0 ? state->base + (idx - 1) : state->top + idx;
+    if (o->tt != LUA_TFUNCTION) return NULL;
+    lua_LClosure* cl = (lua_LClosure*)o->value.gc;
+    return cl->isC ? NULL : cl->p->source;
+}
+
+// Source of innermost lua function on call stack of L, C functions are skipped. NULL if no lua function is running
+inline lua_TString* lua_getrunningchunk(lua_State* L)
+{
+    lua_StateHead* state = (lua_StateHead*)L;
+    for (lua_CallInfo* ci = state->ci; ci > state->base_ci; ci--) {
+        if (ci->func->tt != LUA_TFUNCTION) continue;
+        lua_LClosure* cl = (lua_LClosure*)ci->func->value.gc;
+        if (!cl->isC) return cl->p->source;
+    }
+    return NULL;
+}
+
+inline lua_Alloc lua_getallocf(lua_State* L, void** ud)
+{
+    lua_GlobalStateHead* g = ((lua_StateHead*)L)->l_G;
+    if (ud) *ud = g->ud;
+    return g->frealloc;
+}
+
+inline void lua_setallocf(lua_State* L, lua_Alloc f, void* ud)
+{
+    lua_GlobalStateHead* g = ((lua_StateHead*)L)->l_G;
+    g->frealloc = f;
+    g->ud = ud;
+}
+
 inline void lua_wipe(lua_State* L, int idx)
 {
     if (idx < 0) idx = lua_gettop(L) - (idx + 1);
@@ -552,6 +732,55 @@ inline void lua_wipe(lua_State* L, int idx)
     }
 }
 
+// Result tables: APIs accept optional table which will be filled in place instead of allocating new one
+struct LuaResultTableStats {
+    uint32_t created;
+    uint32_t reused;
+};
+
+inline LuaResultTableStats& lua_resulttablestats()
+{
+    static LuaResultTableStats s_stats = {};
+    return s_stats;
+}
+
+inline void lua_pushresulttable(lua_State* L, int idx, int narr, int nrec)
+{
+    if (lua_istable(L, idx)) {
+        lua_pushvalue(L, idx);
+        lua_resulttablestats().reused++;
+    } else {
+        lua_createtable(L, narr, nrec);
+        lua_resulttablestats().created++;
+    }
+}
+
+// Reuses table at tbl[n] or creates a new one
+inline void lua_pushresultsubtable(lua_State* L, int tbl, int n, int narr, int nrec)
+{
+    if (tbl < 0) tbl = lua_gettop(L) + tbl + 1;
+    lua_rawgeti(L, tbl, n);
+    if (lua_istable(L, -1)) {
+        lua_resulttablestats().reused++;
+        return;
+    }
+    lua_pop(L, 1);
+    lua_createtable(L, narr, nrec);
+    lua_pushvalue(L, -1);
+    lua_rawseti(L, tbl, n);
+    lua_resulttablestats().created++;
+}
+
+// Removes stale array entries left from previous fill, starting with `from`
+inline void lua_wipetail(lua_State* L, int idx, int from)
+{
+    if (idx < 0) idx = lua_gettop(L) + idx + 1;
+    for (int i = lua_objlen(L, idx); i >= from; i--) {
+        lua_pushnil(L);
+        lua_rawseti(L, idx, i);
+    }
+}
+
 inline void lua_pushguid(lua_State* L, guid_t guid)
 {
     char buf[24];
@@ -581,4 +810,52 @@ inline Frame* lua_toframe_silent(lua_State* L, int idx)
 inline void lua_pushframe(lua_State* L, Frame* frame)
 {
     lua_rawgeti(L, LUA_REGISTRYINDEX, CFrame::GetRefTable(frame));
+}
+
+// Name of legacy global the client sets to i'th script argument: event of OnEvent, then arg1..argN
+inline void lua_legacyargname(char* buf, size_t size, bool isEvent, int i)
+{
+    if (isEvent && i == 0) snprintf(buf, size, "event");
+    else snprintf(buf, size, "arg%d", isEvent ? i : i + 1);
+}
+
+/*
+    Calls frame's script handler (OnEvent, OnUpdate, ...) with topmost nargs stack values, stack stays untouched.
+    As the client does, legacy globals this, event and arg1..argN are set for the call and restored afterwards
+*/
+inline void lua_callframescript(lua_State* L, Frame* frame, const char* script, int nargs)
+{
+    int top = lua_gettop(L);
+    bool isEvent = strcmp(script, "OnEvent") == 0;
+    char name[16];
+    lua_rawgeti(L, LUA_REGISTRYINDEX, GetLuaRefErrorHandler()); // args, eh
+    lua_pushframe(L, frame); // args, eh, frame
+    lua_getfield(L, -1, "GetScript"); // args, eh, frame, GetScript
+    lua_pushvalue(L, -2); // args, eh, frame, GetScript, frame
+    lua_pushstring(L, script); // args, eh, frame, GetScript, frame, script
+    if (lua_pcall(L, 2, 1, 0) == 0 && lua_isfunction(L, -1)) { // args, eh, frame, handler
+        // Previous values are kept in a table, stack may be short of room for events with many arguments
+        lua_createtable(L, nargs + 1, 0); // args, eh, frame, handler, saved
+        int saved = lua_gettop(L);
+        for (int i = 0; i <= nargs; i++) {
+            if (i) lua_legacyargname(name, std::size(name), isEvent, i - 1);
+            lua_getglobal(L, i ? name : "this");
+            lua_rawseti(L, saved, i + 1);
+            lua_pushvalue(L, i ? top - nargs + i : top + 2);
+            lua_setglobal(L, i ? name : "this");
+        }
+
+        lua_pushvalue(L, saved - 1); // args, eh, frame, handler, saved, handler
+        lua_pushvalue(L, top + 2); // ..., handler, frame
+        for (int i = 0; i < nargs; i++)
+            lua_pushvalue(L, top - nargs + 1 + i); // ..., handler, frame, args
+        lua_pcall(L, nargs + 1, 0, top + 1);
+
+        for (int i = 0; i <= nargs; i++) {
+            if (i) lua_legacyargname(name, std::size(name), isEvent, i - 1);
+            lua_rawgeti(L, saved, i + 1);
+            lua_setglobal(L, i ? name : "this");
+        }
+    }
+    lua_settop(L, top);
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "Hooks.h"
+#include "StartupTrace.h"
+#include "StubEmitter.h"
 #include <Windows.h>
 #include <Detours/detours.h>
 #include <string>
@@ -9,6 +11,10 @@ namespace VoiceChat {
     void shutdown();  // Forward-Declaration
 }
 
+namespace EventTrace {
+    void shutdown();  // Forward-Declaration
+}
+
 struct CVarArgs {
     Console::CVar** dst;
     const char* name;
@@ -27,6 +33,7 @@ void Hooks::FrameXML::registerCVar(Console::CVar** dst, const char* str, const c
 static void(*CVars_Initialize_orig)() = (decltype(CVars_Initialize_orig))0x0051D9B0;
 static void CVars_Initialize_hk()
 {
+    StartupTrace::Scope scope("CVars_Initialize_hk");
     CVars_Initialize_orig();
     for (const auto& [dst, name, desc, flags, initialValue, func] : s_customCVars) {
         Console::CVar* cvar = Console::RegisterCVar(name, desc, flags, initialValue, func, 0, 0, 0, 0);
@@ -52,25 +59,72 @@ static void FrameScript_FillEvents_hk(const char** list, size_t count)
 static std::vector<lua_CFunction> s_customLuaLibs;
 void Hooks::FrameXML::registerLuaLib(lua_CFunction func) { s_customLuaLibs.push_back(func); }
 
+static std::vector<std::pair<const char*, lua_CFunction>> s_customFrameMethods;
+void Hooks::FrameXML::registerFrameMethod(const char* name, lua_CFunction func) { s_customFrameMethods.push_back({ name, func }); }
+
+static std::vector<std::pair<const char*, lua_CFunction>> s_customFrameMethodOverrides;
+void Hooks::FrameXML::registerFrameMethodOverride(const char* name, lua_CFunction func) { s_customFrameMethodOverrides.push_back({ name, func }); }
+
+static const char s_installFrameMethods[] = R"(
+local methods, overrides = AwesomeWotlkFrameMethods, AwesomeWotlkFrameMethodOverrides
+AwesomeWotlkFrameMethods, AwesomeWotlkFrameMethodOverrides = nil, nil
+local function override(original, func)
+    return function(...)
+        local handled, result = func(...)
+        if handled then return result end
+        return original(...)
+    end
+end
+local patched = {}
+for _, widget in ipairs({ "Frame", "Button", "CheckButton", "StatusBar", "Slider", "EditBox", "ScrollFrame",
+    "MessageFrame", "ScrollingMessageFrame", "SimpleHTML", "Cooldown", "ColorSelect", "GameTooltip", "Model", "PlayerModel" }) do
+    local ok, frame = pcall(CreateFrame, widget)
+    local index = ok and frame and getmetatable(frame).__index
+    if type(index) == "table" and not patched[index] then
+        patched[index] = true
+        for name, func in pairs(methods) do
+            index[name] = func
+        end
+        for name, func in pairs(overrides) do
+            if index[name] then index[name] = override(index[name], func) end
+        end
+    end
+end
+)";
+
 static void Lua_OpenFrameXMlApi_bulk()
 {
-    lua_State* L = GetLuaState();
-    for (auto& func : s_customLuaLibs)
-        func(L);
+    {
+        StartupTrace::Scope scope("Lua_OpenFrameXMlApi_bulk");
+        lua_State* L = GetLuaState();
+        for (auto& func : s_customLuaLibs)
+            func(L);
+
+        if (!s_customFrameMethods.empty() || !s_customFrameMethodOverrides.empty()) {
+            lua_createtable(L, 0, s_customFrameMethods.size()); // methods
+            for (auto& [name, func] : s_customFrameMethods) {
+                lua_pushcfunction(L, func); // methods, func
+                lua_setfield(L, -2, name); // methods
+            }
+            lua_setglobal(L, "AwesomeWotlkFrameMethods");
+            lua_createtable(L, 0, s_customFrameMethodOverrides.size()); // overrides
+            for (auto& [name, func] : s_customFrameMethodOverrides) {
+                lua_pushcfunction(L, func); // overrides, func
+                lua_setfield(L, -2, name); // overrides
+            }
+            lua_setglobal(L, "AwesomeWotlkFrameMethodOverrides");
+            FrameScript::Execute(s_installFrameMethods, APP_NAME, 0);
+        }
+    }
+    // First FrameXML load ends startup
+    StartupTrace::finish();
 }
 
 static void(*Lua_OpenFrameXMLApi_orig)() = (decltype(Lua_OpenFrameXMLApi_orig))0x00530F85;
-static void __declspec(naked) Lua_OpenFrameXMLApi_hk()
-{
-    __asm {
-        pushad;
-        pushfd;
-        call Lua_OpenFrameXMlApi_bulk;
-        popfd;
-        popad;
-        ret;
-    }
-}
+// Tail of the function, only return value is live
+static const StubEmitter::Desc s_openFrameXMLApiStub = {
+    {}, StubEmitter::SaveEax, (const void*)Lua_OpenFrameXMlApi_bulk, {}, StubEmitter::Resume::Return
+};
 
 struct CustomTokenDetails {
     CustomTokenDetails() { memset(this, NULL, sizeof(*this)); }
@@ -95,8 +149,8 @@ static std::unordered_map<std::string, CustomTokenDetails> s_customTokens;
 void Hooks::FrameScript::registerToken(const char* token, TokenGuidGetter* getGuid, TokenIdGetter* getId) { s_customTokens[token] = { getGuid, getId }; }
 void Hooks::FrameScript::registerToken(const char* token, TokenNGuidGetter* getGuid, TokenIdNGetter* getId) { s_customTokens[token] = { getGuid, getId }; }
 
-static DWORD_PTR GetGuidByKeyword_jmpbackaddr = 0;
-static void GetGuidByKeyword_bulk(const char** stackStr, guid_t* guid)
+// Returns address to resume original code at
+static DWORD_PTR GetGuidByKeyword_bulk(const char** stackStr, guid_t* guid)
 {
     for (auto& [token, conv] : s_customTokens) {
         if (strncmp(*stackStr, token.data(), token.size()) == 0) {
@@ -107,31 +161,19 @@ static void GetGuidByKeyword_bulk(const char** stackStr, guid_t* guid)
             } else {
                 *guid = conv.getGuid();
             }
-            GetGuidByKeyword_jmpbackaddr = 0x0060AD57;
-            return;
+            return 0x0060AD57;
         }
     }
-    GetGuidByKeyword_jmpbackaddr = 0x0060AD44;
+    return 0x0060AD44;
 }
 
 static void(*GetGuidByKeyword_orig)() = (decltype(GetGuidByKeyword_orig))0x0060AFAA;
-static void __declspec(naked) GetGuidByKeyword_hk()
-{
-    __asm {
-        pushad;
-        pushfd;
-        push[ebp + 0xC];
-        lea eax, [ebp + 0x8];
-        push eax;
-        call GetGuidByKeyword_bulk;
-        add esp, 8;
-        popfd;
-        popad;
-
-        push GetGuidByKeyword_jmpbackaddr;
-        ret;
-    }
-}
+// Both resume points start new blocks, flags aren't live there
+static const StubEmitter::Desc s_getGuidByKeywordStub = {
+    {}, StubEmitter::SaveEax | StubEmitter::SaveEcx | StubEmitter::SaveEdx, (const void*)GetGuidByKeyword_bulk,
+    { StubEmitter::argAddress(StubEmitter::Ebp, 0x8), StubEmitter::argMemory(StubEmitter::Ebp, 0xC) },
+    StubEmitter::Resume::Returned
+};
 
 static char** (*GetKeywordsByGuid_orig)(guid_t* guid, size_t* size) = (decltype(GetKeywordsByGuid_orig))0x0060BB70;
 static char** GetKeywordsByGuid_hk(guid_t* guid, size_t* size)
@@ -155,94 +197,130 @@ static char** GetKeywordsByGuid_hk(guid_t* guid, size_t* size)
 static std::vector<Hooks::DummyCallback_t> s_customOnUpdate;
 void Hooks::FrameScript::registerOnUpdate(DummyCallback_t func) { s_customOnUpdate.push_back(func); }
 
+static bool s_firingOnUpdate = false;
+bool Hooks::FrameScript::isFiringOnUpdate() { return s_firingOnUpdate; }
+
 static int(*FrameScript_FireOnUpdate_orig)(int a1, int a2, int a3, int a4) = (decltype(FrameScript_FireOnUpdate_orig))0x00495810;
 static int FrameScript_FireOnUpdate_hk(int a1, int a2, int a3, int a4)
 {
+    s_firingOnUpdate = true;
     for (auto func : s_customOnUpdate)
         func();
-    return FrameScript_FireOnUpdate_orig(a1, a2, a3, a4);
+    int result = FrameScript_FireOnUpdate_orig(a1, a2, a3, a4);
+    s_firingOnUpdate = false;
+    return result;
+}
+
+static std::vector<Hooks::FrameScript::EventFilter_t> s_eventFilters;
+void Hooks::FrameScript::registerEventFilter(EventFilter_t func) { s_eventFilters.push_back(func); }
+
+static std::vector<Hooks::FrameScript::EventCallback_t> s_onFireEvent;
+void Hooks::FrameScript::registerOnFireEvent(EventCallback_t func) { s_onFireEvent.push_back(func); }
+
+static std::vector<Hooks::FrameScript::EventTracer_t> s_eventTracers;
+void Hooks::FrameScript::registerEventTracer(EventTracer_t func) { s_eventTracers.push_back(func); }
+
+static int s_firingEvent = -1;
+int Hooks::FrameScript::getFiringEvent() { return s_firingEvent; }
+
+static void(*FrameScript_FireEvent_inner_orig)(int eventId, lua_State* L, int nargs) = (decltype(FrameScript_FireEvent_inner_orig))0x0081AA00;
+static void FrameScript_FireEvent_inner_hk(int eventId, lua_State* L, int nargs)
+{
+    for (auto func : s_eventTracers)
+        func(eventId, L, nargs, true);
+
+    bool dispatch = true;
+    for (auto func : s_eventFilters)
+        if (!func(eventId, L, nargs)) {
+            dispatch = false;
+            break;
+        }
+
+    if (dispatch) {
+        int prevEvent = s_firingEvent;
+        s_firingEvent = eventId;
+        FrameScript_FireEvent_inner_orig(eventId, L, nargs);
+        for (auto func : s_onFireEvent)
+            func(eventId, L, nargs);
+        s_firingEvent = prevEvent;
+    }
+
+    for (auto func : s_eventTracers)
+        func(eventId, L, nargs, false);
 }
 
 static std::vector<Hooks::DummyCallback_t> s_glueXmlPostLoad;
 void Hooks::GlueXML::registerPostLoad(DummyCallback_t func) { s_glueXmlPostLoad.push_back(func); }
 
-static void LoadGlueXML_bulk() { for (auto func : s_glueXmlPostLoad) func(); }
-
-static void (*LoadGlueXML_orig)() = (decltype(LoadGlueXML_orig))0x004DA9AC;
-static void __declspec(naked) LoadGlueXML_hk()
+static void LoadGlueXML_bulk()
 {
-    __asm {
-        pop ebx;
-        mov esp, ebp;
-        pop ebp;
-
-        pushad;
-        pushfd;
-        call LoadGlueXML_bulk;
-        popfd;
-        popad;
-        ret;
+    {
+        StartupTrace::Scope scope("LoadGlueXML_bulk");
+        for (auto func : s_glueXmlPostLoad)
+            func();
     }
+    StartupTrace::report();
 }
 
+static void (*LoadGlueXML_orig)() = (decltype(LoadGlueXML_orig))0x004DA9AC;
+// Replaces function epilogue: pop ebx; mov esp, ebp; pop ebp
+static const StubEmitter::Desc s_loadGlueXMLStub = {
+    { 0x5B, 0x8B, 0xE5, 0x5D }, StubEmitter::SaveEax, (const void*)LoadGlueXML_bulk, {}, StubEmitter::Resume::Return
+};
+
 
 static std::vector<Hooks::DummyCallback_t> s_glueXmlCharEnum;
 void Hooks::GlueXML::registerCharEnum(DummyCallback_t func) { s_glueXmlCharEnum.push_back(func); }
 
 static void LoadCharacters_bulk()
 {
+    StartupTrace::Scope scope("LoadCharacters_bulk");
     for (auto func : s_glueXmlCharEnum)
         func();
 }
 
 static void (*LoadCharacters_orig)() = (decltype(LoadCharacters_orig))0x004E47E5;
-static void __declspec(naked) LoadCharacters_hk()
-{
-    __asm {
-        add esp, 8;
-        pop esi;
-
-        pushad;
-        pushfd;
-        call LoadCharacters_bulk;
-        popfd;
-        popad;
-
-        ret;
-    }
-}
+// Replaces function epilogue: add esp, 8; pop esi
+static const StubEmitter::Desc s_loadCharactersStub = {
+    { 0x83, 0xC4, 0x08, 0x5E }, StubEmitter::SaveEax, (const void*)LoadCharacters_bulk, {}, StubEmitter::Resume::Return
+};
 
 
 using tCGameDestroy = void(__thiscall*)(void* self);
 static tCGameDestroy CGame_Destroy_orig =
     (decltype(CGame_Destroy_orig))0x00406B70;
 
-static void __declspec(naked) CGame_Destroy_hk()
+static void CGame_Destroy_bulk()
 {
-    __asm {
-        pushad
-        pushfd
-    }
-
+    EventTrace::shutdown();
     VoiceChat::shutdown();
-
-    __asm {
-        popfd
-        popad
-        mov eax, CGame_Destroy_orig
-        jmp eax
-    }
 }
 
-void Hooks::initialize()
+// Function entry, only this pointer in ecx is live. Continues to detours trampoline
+static const StubEmitter::Desc s_gameDestroyStub = {
+    {}, StubEmitter::SaveEcx, (const void*)CGame_Destroy_bulk, {}, StubEmitter::Resume::JumpIndirect, (uintptr_t)&CGame_Destroy_orig
+};
+
+bool Hooks::initialize()
 {
-    DetourAttach(&(LPVOID&)CVars_Initialize_orig, CVars_Initialize_hk);
-    DetourAttach(&(LPVOID&)FrameScript_FireOnUpdate_orig, FrameScript_FireOnUpdate_hk);
-    DetourAttach(&(LPVOID&)FrameScript_FillEvents_orig, FrameScript_FillEvents_hk);
-    DetourAttach(&(LPVOID&)Lua_OpenFrameXMLApi_orig, Lua_OpenFrameXMLApi_hk);
-    DetourAttach(&(LPVOID&)GetGuidByKeyword_orig, GetGuidByKeyword_hk);
-    DetourAttach(&(LPVOID&)GetKeywordsByGuid_orig, GetKeywordsByGuid_hk);
-    DetourAttach(&(LPVOID&)LoadGlueXML_orig, LoadGlueXML_hk);
-    DetourAttach(&(LPVOID&)LoadCharacters_orig, LoadCharacters_hk);
-    DetourAttach(&(LPVOID&)CGame_Destroy_orig, CGame_Destroy_hk);
+    void* Lua_OpenFrameXMLApi_hk = StubEmitter::emit(s_openFrameXMLApiStub);
+    void* GetGuidByKeyword_hk = StubEmitter::emit(s_getGuidByKeywordStub);
+    void* LoadGlueXML_hk = StubEmitter::emit(s_loadGlueXMLStub);
+    void* LoadCharacters_hk = StubEmitter::emit(s_loadCharactersStub);
+    void* CGame_Destroy_hk = StubEmitter::emit(s_gameDestroyStub);
+    // Detouring to NULL would crash on first call, other modules can't work without these hooks either
+    if (!Lua_OpenFrameXMLApi_hk || !GetGuidByKeyword_hk || !LoadGlueXML_hk || !LoadCharacters_hk || !CGame_Destroy_hk)
+        return false;
+
+    DETOUR_ATTACH_TRACED(CVars_Initialize_orig, CVars_Initialize_hk);
+    DETOUR_ATTACH_TRACED(FrameScript_FireOnUpdate_orig, FrameScript_FireOnUpdate_hk);
+    DETOUR_ATTACH_TRACED(FrameScript_FillEvents_orig, FrameScript_FillEvents_hk);
+    DETOUR_ATTACH_TRACED(FrameScript_FireEvent_inner_orig, FrameScript_FireEvent_inner_hk);
+    DETOUR_ATTACH_TRACED(Lua_OpenFrameXMLApi_orig, Lua_OpenFrameXMLApi_hk);
+    DETOUR_ATTACH_TRACED(GetGuidByKeyword_orig, GetGuidByKeyword_hk);
+    DETOUR_ATTACH_TRACED(GetKeywordsByGuid_orig, GetKeywordsByGuid_hk);
+    DETOUR_ATTACH_TRACED(LoadGlueXML_orig, LoadGlueXML_hk);
+    DETOUR_ATTACH_TRACED(LoadCharacters_orig, LoadCharacters_hk);
+    DETOUR_ATTACH_TRACED(CGame_Destroy_orig, CGame_Destroy_hk);
+    return true;
 }
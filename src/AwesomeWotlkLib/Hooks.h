@@ -16,12 +16,32 @@ void registerToken(const char* token, TokenGuidGetter* getGuid, TokenIdGetter* g
 // One more tokens like party1, raid1, arena1
 void registerToken(const char* token, TokenNGuidGetter* getGuid, TokenIdNGetter* getId);
 void registerOnUpdate(DummyCallback_t func);
+
+// Event arguments (event name first) are the topmost nargs values on the stack
+using EventFilter_t = bool(*)(int eventId, lua_State* L, int nargs);
+using EventCallback_t = void(*)(int eventId, lua_State* L, int nargs);
+using EventTracer_t = void(*)(int eventId, lua_State* L, int nargs, bool begin);
+// Called before dispatching, return false to swallow event
+void registerEventFilter(EventFilter_t func);
+// Called after event was dispatched to registered frames
+void registerOnFireEvent(EventCallback_t func);
+// Called when event enters (before filters) and leaves dispatching, swallowed events included
+void registerEventTracer(EventTracer_t func);
+// Event being dispatched right now, -1 if none
+int getFiringEvent();
+// True while OnUpdate callbacks and scripts are running
+bool isFiringOnUpdate();
 }
 
 namespace FrameXML {
 void registerEvent(const char* str);
 void registerCVar(Console::CVar** dst, const char* str, const char* desc, Console::CVarFlags flags, const char* initialValue, Console::CVar::Handler_t func);
 void registerLuaLib(lua_CFunction func);
+// Adds method to all widget types, e.g. Frame:Method()
+void registerFrameMethod(const char* name, lua_CFunction func);
+// Wraps existing method of all widget types. func returns true and one result when it handled the call,
+// nothing to let the original method run with the same arguments
+void registerFrameMethodOverride(const char* name, lua_CFunction func);
 }
 
 namespace GlueXML {
@@ -29,6 +49,7 @@ void registerPostLoad(DummyCallback_t func);
 void registerCharEnum(DummyCallback_t func);
 }
 
-void initialize();
+// False if hook thunks couldn't be emitted, nothing is attached then
+bool initialize();
 
 }
\ No newline at end of file
@@ -0,0 +1,461 @@
+#include "LuaAllocator.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include "Profiler.h"
+#include "SlabPool.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#undef min
+#undef max
+
+/*
+    Replacement allocator of client lua state. Small blocks are served by SlabPool from region reserved
+    here, client allocator is its fallback.
+
+    While tracking is enabled every block is tagged with addon owning the lua function running at the moment
+    of allocation (see Profiler::getRunningAddon), tag follows the block through reallocs and is used to charge
+    its size back on free. Blocks allocated before tracking started have no tag and aren't counted.
+    Each Nth allocation also records native stack signature to group allocation sites, frames of this module
+    are skipped by address so the signature starts at the client code that allocated.
+*/
+
+constexpr size_t POOL_REGION_SIZE = 64 * 1024 * 1024;
+constexpr size_t POOL_NUM_PAGES = POOL_REGION_SIZE / SlabPool::PAGE_SIZE;
+constexpr uint16_t TRACK_NO_TAG = 0;
+constexpr size_t TRACK_SITE_FRAMES = 6;
+constexpr size_t TRACK_CAPTURE_FRAMES = 16;
+constexpr size_t TRACK_MAX_SITES = 4096;
+constexpr uint32_t SNAPSHOT_MAGIC = 'SMWA'; // "AWMS"
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+struct AddonMemory {
+    int64_t liveBytes;
+    uint64_t allocatedBytes;
+    uint64_t allocatedAtRate;
+    double rate; // bytes per second
+};
+
+struct AllocationSite {
+    uint16_t tag;
+    uint32_t samples;
+    uint64_t bytes;
+    void* frames[TRACK_SITE_FRAMES];
+};
+
+static Console::CVar* s_cvar_luaPoolAllocator;
+
+// Tag is addon id + 1, TRACK_NO_TAG for untracked blocks
+static bool s_tracking = false;
+static uint32_t s_sampleRate = 1000;
+static uint32_t s_sampleCounter = 0;
+static uint32_t s_snapshotInterval = 0;
+static std::unique_ptr<uint16_t[]> s_pageTags[POOL_NUM_PAGES];
+static std::unordered_map<void*, uint16_t> s_fallbackTags;
+static std::vector<AddonMemory> s_addonMemory;
+static std::unordered_map<uint32_t, AllocationSite> s_sites;
+static FILE* s_snapshotFile = NULL;
+static size_t s_snapshotNames = 0;
+static DWORD s_lastRateTick = 0;
+static DWORD s_lastSnapshotTick = 0;
+
+static bool commitPage(void* page, size_t size)
+{
+    return VirtualAlloc(page, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+static uint16_t* pageTagOf(const void* ptr, bool create)
+{
+    size_t page = SlabPool::pageOf(ptr);
+    std::unique_ptr<uint16_t[]>& tags = s_pageTags[page];
+    if (!tags) {
+        if (!create) return NULL;
+        tags = std::make_unique<uint16_t[]>(SlabPool::blocksPerPage(page));
+    }
+    return &tags[SlabPool::blockOf(ptr)];
+}
+
+static void setTag(void* ptr, uint16_t tag)
+{
+    if (SlabPool::isPooled(ptr)) *pageTagOf(ptr, true) = tag;
+    else s_fallbackTags[ptr] = tag;
+}
+
+static uint16_t takeTag(void* ptr)
+{
+    uint16_t tag = TRACK_NO_TAG;
+    if (SlabPool::isPooled(ptr)) {
+        if (uint16_t* slot = pageTagOf(ptr, false)) {
+            tag = *slot;
+            *slot = TRACK_NO_TAG;
+        }
+    } else {
+        auto it = s_fallbackTags.find(ptr);
+        if (it != s_fallbackTags.end()) {
+            tag = it->second;
+            s_fallbackTags.erase(it);
+        }
+    }
+    return tag;
+}
+
+static AddonMemory& addonMemory(uint16_t tag)
+{
+    if (tag >= s_addonMemory.size()) s_addonMemory.resize(tag + 1);
+    return s_addonMemory[tag];
+}
+
+extern "C" IMAGE_DOS_HEADER __ImageBase;
+
+static bool isOwnCode(const void* address)
+{
+    static const char* s_begin = (const char*)&__ImageBase;
+    static const char* s_end = s_begin + ((const IMAGE_NT_HEADERS*)(s_begin + __ImageBase.e_lfanew))->OptionalHeader.SizeOfImage;
+    return address >= s_begin && address < s_end;
+}
+
+static void sampleSite(uint16_t tag, size_t size)
+{
+    void* captured[TRACK_CAPTURE_FRAMES];
+    USHORT count = CaptureStackBackTrace(0, TRACK_CAPTURE_FRAMES, captured, NULL);
+    size_t first = 0;
+    while (first < count && isOwnCode(captured[first])) first++;
+
+    void* frames[TRACK_SITE_FRAMES] = {};
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < TRACK_SITE_FRAMES && first + i < count; i++) {
+        frames[i] = captured[first + i];
+        hash = (hash ^ (uint32_t)(uintptr_t)frames[i]) * 16777619u;
+    }
+    uint32_t key = hash ^ (tag * 0x9E3779B9u);
+    auto it = s_sites.find(key);
+    if (it == s_sites.end()) {
+        if (s_sites.size() >= TRACK_MAX_SITES) return;
+        it = s_sites.emplace(key, AllocationSite{ tag }).first;
+        std::copy(std::begin(frames), std::end(frames), it->second.frames);
+    }
+    it->second.samples++;
+    it->second.bytes += size;
+}
+
+static void trackAlloc(void* ptr, size_t size)
+{
+    uint16_t tag = Profiler::getRunningAddon() + 1;
+    setTag(ptr, tag);
+    AddonMemory& mem = addonMemory(tag);
+    mem.liveBytes += size;
+    mem.allocatedBytes += size;
+    if (++s_sampleCounter >= s_sampleRate) {
+        s_sampleCounter = 0;
+        sampleSite(tag, size);
+    }
+}
+
+static void trackFree(void* ptr, size_t size)
+{
+    uint16_t tag = takeTag(ptr);
+    if (tag != TRACK_NO_TAG) s_addonMemory[tag].liveBytes -= size;
+}
+
+// Block keeps its owner, growth is charged to addon which allocated it
+static void trackRealloc(void* ptr, void* result, size_t osize, size_t nsize)
+{
+    uint16_t tag = takeTag(ptr);
+    if (tag == TRACK_NO_TAG) return;
+    setTag(result, tag);
+    AddonMemory& mem = s_addonMemory[tag];
+    mem.liveBytes += (int64_t)nsize - (int64_t)osize;
+    if (nsize > osize) mem.allocatedBytes += nsize - osize;
+}
+
+static void* luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    void* result = SlabPool::alloc(ptr, osize, nsize);
+    if (!s_tracking) return result;
+
+    // Tags are kept apart from blocks, so they can be looked up by address after block moved or was freed
+    if (nsize == 0) {
+        if (ptr) trackFree(ptr, osize);
+    } else if (!ptr) {
+        if (result) trackAlloc(result, nsize);
+    } else if (result) {
+        trackRealloc(ptr, result, osize, nsize);
+    }
+    return result;
+}
+
+static void installAllocator(lua_State* L)
+{
+    void* ud;
+    lua_Alloc current = lua_getallocf(L, &ud);
+    if (current == luaAlloc) return;
+
+    // Client uses the same allocator for every state it creates, everything allocated so far belongs to it
+    size_t liveBytes = (size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+    SlabPool::setFallback(current, ud, liveBytes);
+    lua_setallocf(L, luaAlloc, NULL);
+}
+
+static void resetTracking()
+{
+    for (std::unique_ptr<uint16_t[]>& tags : s_pageTags)
+        tags.reset();
+    s_fallbackTags.clear();
+    s_addonMemory.clear();
+    s_sites.clear();
+    s_sampleCounter = 0;
+    s_lastRateTick = s_lastSnapshotTick = GetTickCount();
+}
+
+static void closeSnapshotFile()
+{
+    if (!s_snapshotFile) return;
+    fclose(s_snapshotFile);
+    s_snapshotFile = NULL;
+}
+
+/*
+    Logs\LuaMemory.bin, little-endian, appended by each tracking session:
+        session: u32 magic "AWMS", u32 version, u64 unix time
+        name:    u8 1, u16 addon id, u16 length, char[length]     (written once per addon per session)
+        sample:  u8 2, u32 ms since session start, u16 count, count * { u16 addon id, i32 live bytes, u32 bytes/s }
+*/
+static void writeSnapshot()
+{
+    if (!s_snapshotFile) {
+        CreateDirectoryA("Logs", NULL);
+        if (fopen_s(&s_snapshotFile, "Logs\\LuaMemory.bin", "ab") || !s_snapshotFile) {
+            s_snapshotInterval = 0;
+            return;
+        }
+        uint32_t header[2] = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION };
+        uint64_t now = (uint64_t)time(NULL);
+        fwrite(header, sizeof(header), 1, s_snapshotFile);
+        fwrite(&now, sizeof(now), 1, s_snapshotFile);
+        s_snapshotNames = 0;
+    }
+
+    for (; s_snapshotNames + 1 < s_addonMemory.size(); s_snapshotNames++) {
+        const char* name = Profiler::getAddonName(s_snapshotNames);
+        uint8_t type = 1;
+        uint16_t id = s_snapshotNames, len = name ? strlen(name) : 0;
+        fwrite(&type, 1, 1, s_snapshotFile);
+        fwrite(&id, 2, 1, s_snapshotFile);
+        fwrite(&len, 2, 1, s_snapshotFile);
+        fwrite(name, 1, len, s_snapshotFile);
+    }
+
+    uint8_t type = 2;
+    uint32_t timeMs = GetTickCount() - s_lastSnapshotTick;
+    uint16_t count = s_addonMemory.size() ? s_addonMemory.size() - 1 : 0;
+    fwrite(&type, 1, 1, s_snapshotFile);
+    fwrite(&timeMs, 4, 1, s_snapshotFile);
+    fwrite(&count, 2, 1, s_snapshotFile);
+    for (uint16_t tag = 1; tag <= count; tag++) {
+        const AddonMemory& mem = s_addonMemory[tag];
+        uint16_t id = tag - 1;
+        int32_t live = (int32_t)std::clamp<int64_t>(mem.liveBytes, INT32_MIN, INT32_MAX);
+        uint32_t rate = (uint32_t)mem.rate;
+        fwrite(&id, 2, 1, s_snapshotFile);
+        fwrite(&live, 4, 1, s_snapshotFile);
+        fwrite(&rate, 4, 1, s_snapshotFile);
+    }
+    fflush(s_snapshotFile);
+}
+
+static void onUpdateCallback()
+{
+    if (!s_tracking) return;
+
+    DWORD now = GetTickCount();
+    DWORD elapsed = now - s_lastRateTick;
+    if (elapsed >= 1000) {
+        for (AddonMemory& mem : s_addonMemory) {
+            mem.rate = (mem.allocatedBytes - mem.allocatedAtRate) * 1000.0 / elapsed;
+            mem.allocatedAtRate = mem.allocatedBytes;
+        }
+        s_lastRateTick = now;
+    }
+
+    static DWORD s_lastWrite = 0;
+    if (s_snapshotInterval && now - s_lastWrite >= s_snapshotInterval * 1000) {
+        writeSnapshot();
+        s_lastWrite = now;
+    }
+}
+
+static int C_Memory_GetAllocatorStats(lua_State* L)
+{
+    SlabPool::Stats stats = SlabPool::getStats();
+    lua_pushresulttable(L, 1, 0, 8); // stats
+    lua_pushnumber(L, stats.liveBytes);
+    lua_setfield(L, -2, "liveBytes");
+    lua_pushnumber(L, stats.pooledBytes);
+    lua_setfield(L, -2, "pooledBytes");
+    lua_pushnumber(L, stats.fallbackBytes);
+    lua_setfield(L, -2, "fallbackBytes");
+    lua_pushnumber(L, stats.committedBytes);
+    lua_setfield(L, -2, "committedBytes");
+    lua_pushnumber(L, stats.allocs);
+    lua_setfield(L, -2, "allocs");
+    lua_pushnumber(L, stats.frees);
+    lua_setfield(L, -2, "frees");
+    lua_pushnumber(L, stats.fragmentation);
+    lua_setfield(L, -2, "fragmentation");
+    lua_pushnumber(L, stats.internalFragmentation);
+    lua_setfield(L, -2, "internalFragmentation");
+
+    lua_getfield(L, -1, "classes"); // stats, classes
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1); // stats
+        lua_createtable(L, SlabPool::NUM_CLASSES, 0); // stats, classes
+        lua_pushvalue(L, -1); // stats, classes, classes
+        lua_setfield(L, -3, "classes"); // stats, classes
+    }
+    for (size_t i = 0; i < SlabPool::NUM_CLASSES; i++) {
+        SlabPool::ClassStats sc = SlabPool::getClassStats(i);
+        lua_pushresultsubtable(L, -1, i + 1, 0, 4); // stats, classes, class
+        lua_pushnumber(L, sc.size);
+        lua_setfield(L, -2, "size");
+        lua_pushnumber(L, sc.used);
+        lua_setfield(L, -2, "used");
+        lua_pushnumber(L, sc.total);
+        lua_setfield(L, -2, "total");
+        lua_pushnumber(L, sc.pages);
+        lua_setfield(L, -2, "pages");
+        lua_pop(L, 1); // stats, classes
+    }
+    lua_pop(L, 1); // stats
+    return 1;
+}
+
+static int C_Memory_StartTracking(lua_State* L)
+{
+    s_sampleRate = lua_isnoneornil(L, 1) ? 1000 : std::max(1, (int)luaL_checknumber(L, 1));
+    s_snapshotInterval = lua_isnoneornil(L, 2) ? 0 : std::max(0, (int)luaL_checknumber(L, 2));
+    if (!s_tracking) {
+        resetTracking();
+        closeSnapshotFile();
+    }
+    s_tracking = true;
+    Profiler::setAttribution(true);
+    return 0;
+}
+
+static int C_Memory_StopTracking(lua_State* L)
+{
+    s_tracking = false;
+    Profiler::setAttribution(false);
+    closeSnapshotFile();
+    return 0;
+}
+
+static int C_Memory_IsTracking(lua_State* L)
+{
+    if (!s_tracking) return 0;
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int C_Memory_GetAddOnMemory(lua_State* L)
+{
+    lua_pushresulttable(L, 1, 0, s_addonMemory.size()); // tbl
+    for (uint16_t tag = 1; tag < s_addonMemory.size(); tag++) {
+        const char* name = Profiler::getAddonName(tag - 1);
+        const AddonMemory& mem = s_addonMemory[tag];
+        if (!name || (!mem.allocatedBytes && !mem.liveBytes)) continue;
+
+        lua_getfield(L, -1, name); // tbl, entry
+        if (!lua_istable(L, -1)) {
+            lua_pop(L, 1); // tbl
+            lua_createtable(L, 0, 3); // tbl, entry
+            lua_pushvalue(L, -1); // tbl, entry, entry
+            lua_setfield(L, -3, name); // tbl, entry
+        }
+        lua_pushnumber(L, (double)mem.liveBytes);
+        lua_setfield(L, -2, "liveBytes");
+        lua_pushnumber(L, (double)mem.allocatedBytes);
+        lua_setfield(L, -2, "allocatedBytes");
+        lua_pushnumber(L, mem.rate);
+        lua_setfield(L, -2, "allocRate");
+        lua_pop(L, 1); // tbl
+    }
+    return 1;
+}
+
+static int C_Memory_GetAllocationSites(lua_State* L)
+{
+    static std::vector<const AllocationSite*> s_sorted;
+    size_t count = lua_isnoneornil(L, 1) ? 20 : std::max(0, (int)luaL_checknumber(L, 1));
+
+    s_sorted.clear();
+    for (auto& [key, site] : s_sites)
+        s_sorted.push_back(&site);
+    count = std::min(count, s_sorted.size());
+    std::partial_sort(s_sorted.begin(), s_sorted.begin() + count, s_sorted.end(), [](const AllocationSite* a, const AllocationSite* b) {
+        return a->bytes > b->bytes;
+    });
+
+    lua_pushresulttable(L, 2, count, 0); // tbl
+    for (size_t i = 0; i < count; i++) {
+        const AllocationSite& site = *s_sorted[i];
+        char frames[TRACK_SITE_FRAMES * 12] = {};
+        for (size_t j = 0, len = 0; j < TRACK_SITE_FRAMES && site.frames[j]; j++)
+            len += snprintf(frames + len, std::size(frames) - len, j ? " < %08X" : "%08X", (uint32_t)(uintptr_t)site.frames[j]);
+
+        lua_pushresultsubtable(L, -1, i + 1, 0, 4); // tbl, site
+        const char* name = Profiler::getAddonName(site.tag - 1);
+        lua_pushstring(L, name ? name : "");
+        lua_setfield(L, -2, "addon");
+        lua_pushnumber(L, site.samples);
+        lua_setfield(L, -2, "samples");
+        // Estimation of all bytes allocated from this site
+        lua_pushnumber(L, (double)site.bytes * s_sampleRate);
+        lua_setfield(L, -2, "bytes");
+        lua_pushstring(L, frames);
+        lua_setfield(L, -2, "stack");
+        lua_pop(L, 1); // tbl
+    }
+    lua_wipetail(L, -1, count + 1);
+    return 1;
+}
+
+static int lua_openlibmemory(lua_State* L)
+{
+    // Allocator is always replaced to keep tracking possible, cvar controls only pooling
+    SlabPool::setEnabled(s_cvar_luaPoolAllocator && s_cvar_luaPoolAllocator->vStr && atoi(s_cvar_luaPoolAllocator->vStr));
+    installAllocator(L);
+    // Blocks of previous state are gone with it
+    if (s_tracking) resetTracking();
+
+    luaL_Reg methods[] = {
+        {"GetAllocatorStats", C_Memory_GetAllocatorStats},
+        {"StartTracking", C_Memory_StartTracking},
+        {"StopTracking", C_Memory_StopTracking},
+        {"IsTracking", C_Memory_IsTracking},
+        {"GetAddOnMemory", C_Memory_GetAddOnMemory},
+        {"GetAllocationSites", C_Memory_GetAllocationSites},
+    };
+
+    lua_createtable(L, 0, std::size(methods));
+    for (size_t i = 0; i < std::size(methods); i++) {
+        lua_pushcfunction(L, methods[i].func);
+        lua_setfield(L, -2, methods[i].name);
+    }
+    lua_setglobal(L, "C_Memory");
+    return 0;
+}
+
+void LuaAllocator::initialize()
+{
+    char* region = (char*)VirtualAlloc(NULL, POOL_REGION_SIZE, MEM_RESERVE, PAGE_READWRITE);
+    SlabPool::initialize(region, POOL_REGION_SIZE, commitPage);
+
+    Hooks::FrameXML::registerCVar(&s_cvar_luaPoolAllocator, "luaPoolAllocator", NULL, (Console::CVarFlags)1, "1", NULL);
+    Hooks::FrameXML::registerLuaLib(lua_openlibmemory);
+    Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
+}
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "LuaGC.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include "Objects.h"
+#include <Windows.h>
+#include <algorithm>
+#include <climits>
+
+/*
+    GC pacing: collector work is moved into frames which finished faster than gcFrameTime, each such frame
+    spends its spare time (at most gcMaxStepTime) in small lua_gc steps. While player is in combat the collector
+    is stopped until heap grows by gcCombatPause percent or reaches gcCombatMaxKB, so allocation bursts don't trigger
+    steps mid-fight. The cap keeps held garbage from exhausting address space of 32-bit client.
+*/
+struct GCStats {
+    uint32_t steps;
+    uint32_t cycles;
+    uint32_t idleFrames;
+    uint32_t combatFrames;
+    uint32_t combatLimitHits;
+    double stepTime; // ms
+    double lastFrameTime; // ms
+};
+
+static Console::CVar* s_cvar_gcPacing;
+static Console::CVar* s_cvar_gcFrameTime;
+static Console::CVar* s_cvar_gcMaxStepTime;
+static Console::CVar* s_cvar_gcCombatPause;
+static Console::CVar* s_cvar_gcCombatMaxKB;
+static bool s_enabled = false;
+static double s_frameTime = 16.7;
+static double s_maxStepTime = 2.0;
+static double s_combatPause = 100.0;
+static int s_combatMaxKB = 65536;
+
+static LARGE_INTEGER s_frequency;
+static LARGE_INTEGER s_lastUpdate;
+static GCStats s_stats;
+static bool s_stopped = false; // collector is held by combat
+static int s_combatLimit = 0; // KB
+static int s_cycleEndCount = 0; // KB, heap size when pacing finished last cycle
+
+static double elapsedMs(const LARGE_INTEGER& from, const LARGE_INTEGER& to)
+{
+    return (double)(to.QuadPart - from.QuadPart) * 1000.0 / s_frequency.QuadPart;
+}
+
+static bool isPlayerInCombat()
+{
+    const Objects::Snapshot& objects = Objects::get();
+    return objects.player >= 0 && (objects.flags[objects.player] & UNIT_FLAG_IN_COMBAT);
+}
+
+static void releaseCollector(lua_State* L)
+{
+    if (!s_stopped) return;
+    lua_gc(L, LUA_GCRESTART, 0);
+    s_stopped = false;
+}
+
+static void runIdleSteps(lua_State* L, const LARGE_INTEGER& frameStart, double budget)
+{
+    // Idle frames start a new cycle only once heap grew by a quarter since pacing finished previous one
+    int count = lua_gc(L, LUA_GCCOUNT, 0);
+    if (count < s_cycleEndCount + s_cycleEndCount / 4) return;
+
+    LARGE_INTEGER now;
+    do {
+        s_stats.steps++;
+        if (lua_gc(L, LUA_GCSTEP, 0)) {
+            s_stats.cycles++;
+            s_cycleEndCount = lua_gc(L, LUA_GCCOUNT, 0);
+            QueryPerformanceCounter(&now);
+            break;
+        }
+        QueryPerformanceCounter(&now);
+    } while (elapsedMs(frameStart, now) < budget);
+    s_stats.stepTime += elapsedMs(frameStart, now);
+}
+
+static void onUpdateCallback()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    double frameTime = elapsedMs(s_lastUpdate, now);
+    s_lastUpdate = now;
+    s_stats.lastFrameTime = frameTime;
+
+    lua_State* L = GetLuaState();
+    if (!s_enabled) {
+        releaseCollector(L);
+        return;
+    }
+
+    if (isPlayerInCombat()) {
+        s_stats.combatFrames++;
+        if (!s_stopped) {
+            int count = lua_gc(L, LUA_GCCOUNT, 0);
+            s_combatLimit = (std::min)(count + (int)(count * s_combatPause / 100.0), s_combatMaxKB);
+            lua_gc(L, LUA_GCSTOP, 0);
+            s_stopped = true;
+        } else if (lua_gc(L, LUA_GCCOUNT, 0) >= s_combatLimit) {
+            // Heap outgrew the limit, held debt is paid by a step now and collector goes back to its own pace until combat ends
+            s_stats.combatLimitHits++;
+            lua_gc(L, LUA_GCRESTART, 0);
+            lua_gc(L, LUA_GCSTEP, 0);
+            s_combatLimit = INT_MAX;
+        }
+        return;
+    }
+
+    if (s_stopped) {
+        releaseCollector(L);
+        s_cycleEndCount = 0; // debt of combat is paid in following idle frames
+    }
+
+    double spare = s_frameTime - frameTime;
+    if (spare <= 0.0) return;
+    s_stats.idleFrames++;
+    runIdleSteps(L, now, (std::min)(spare, s_maxStepTime));
+}
+
+static int CVarHandler_gcPacing(Console::CVar*, const char*, const char* value, void*)
+{
+    s_enabled = atoi(value) != 0;
+    return 1;
+}
+
+static int CVarHandler_gcFrameTime(Console::CVar*, const char*, const char* value, void*)
+{
+    double f = atof(value);
+    s_frameTime = f > 0.0 ? f : 16.7;
+    return 1;
+}
+
+static int CVarHandler_gcMaxStepTime(Console::CVar*, const char*, const char* value, void*)
+{
+    double f = atof(value);
+    s_maxStepTime = f >= 0.0 ? f : 2.0;
+    return 1;
+}
+
+static int CVarHandler_gcCombatPause(Console::CVar*, const char*, const char* value, void*)
+{
+    double f = atof(value);
+    s_combatPause = f >= 0.0 ? f : 100.0;
+    return 1;
+}
+
+static int CVarHandler_gcCombatMaxKB(Console::CVar*, const char*, const char* value, void*)
+{
+    int kb = atoi(value);
+    s_combatMaxKB = kb > 0 ? kb : 65536;
+    return 1;
+}
+
+static int lua_GetGCPacingStats(lua_State* L)
+{
+    lua_pushresulttable(L, 1, 0, 9); // tbl
+    lua_pushnumber(L, s_stats.steps);
+    lua_setfield(L, -2, "steps");
+    lua_pushnumber(L, s_stats.cycles);
+    lua_setfield(L, -2, "cycles");
+    lua_pushnumber(L, s_stats.stepTime);
+    lua_setfield(L, -2, "stepTime");
+    lua_pushnumber(L, s_stats.idleFrames);
+    lua_setfield(L, -2, "idleFrames");
+    lua_pushnumber(L, s_stats.combatFrames);
+    lua_setfield(L, -2, "combatFrames");
+    lua_pushnumber(L, s_stats.combatLimitHits);
+    lua_setfield(L, -2, "combatLimitHits");
+    lua_pushnumber(L, s_stats.lastFrameTime);
+    lua_setfield(L, -2, "lastFrameTime");
+    lua_pushnumber(L, lua_gc(L, LUA_GCCOUNT, 0));
+    lua_setfield(L, -2, "heapKB");
+    if (s_stopped) lua_pushnumber(L, 1);
+    else lua_pushnil(L);
+    lua_setfield(L, -2, "deferred");
+    return 1;
+}
+
+static int lua_openlibgc(lua_State* L)
+{
+    // New state starts with running collector
+    s_stopped = false;
+    s_cycleEndCount = 0;
+    s_stats = {};
+
+    lua_pushcfunction(L, lua_GetGCPacingStats);
+    lua_setglobal(L, "GetGCPacingStats");
+    return 0;
+}
+
+void LuaGC::initialize()
+{
+    QueryPerformanceFrequency(&s_frequency);
+    QueryPerformanceCounter(&s_lastUpdate);
+
+    Hooks::FrameXML::registerLuaLib(lua_openlibgc);
+    Hooks::FrameXML::registerCVar(&s_cvar_gcPacing, "gcPacing", NULL, (Console::CVarFlags)1, "0", CVarHandler_gcPacing);
+    Hooks::FrameXML::registerCVar(&s_cvar_gcFrameTime, "gcFrameTime", NULL, (Console::CVarFlags)1, "16.7", CVarHandler_gcFrameTime);
+    Hooks::FrameXML::registerCVar(&s_cvar_gcMaxStepTime, "gcMaxStepTime", NULL, (Console::CVarFlags)1, "2", CVarHandler_gcMaxStepTime);
+    Hooks::FrameXML::registerCVar(&s_cvar_gcCombatPause, "gcCombatPause", NULL, (Console::CVarFlags)1, "100", CVarHandler_gcCombatPause);
+    Hooks::FrameXML::registerCVar(&s_cvar_gcCombatMaxKB, "gcCombatMaxKB", NULL, (Console::CVarFlags)1, "65536", CVarHandler_gcCombatMaxKB);
+    Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "GameClient.h"
 #include "Hooks.h"
 #include "Utils.h"
+#include "StartupTrace.h"
 #include <Windows.h>
 #include <Detours/detours.h>
 #define M_PI           3.14159265358979323846
@@ -41,6 +42,14 @@ static int lua_CopyToClipboard(lua_State* L)
     return 0;
 }
 
+static int lua_GetResultTableStats(lua_State* L)
+{
+    LuaResultTableStats& stats = lua_resulttablestats();
+    lua_pushnumber(L, stats.created);
+    lua_pushnumber(L, stats.reused);
+    return 2;
+}
+
 static int lua_openmisclib(lua_State* L)
 {
     luaL_Reg funcs[] = {
@@ -48,6 +57,7 @@ static int lua_openmisclib(lua_State* L)
         { "IsWindowFocused", lua_IsWindowFocused },
         { "FocusWindow", lua_FocusWindow },
         { "CopyToClipboard", lua_CopyToClipboard },
+        { "GetResultTableStats", lua_GetResultTableStats },
     };
 
     for (const auto& [name, func] : funcs) {
@@ -78,5 +88,5 @@ void Misc::initialize()
     Hooks::FrameXML::registerCVar(&s_cvar_cameraFov, "cameraFov", NULL, (Console::CVarFlags)1, "100", CVarHandler_cameraFov);
     Hooks::FrameXML::registerLuaLib(lua_openmisclib);
 
-    DetourAttach(&(LPVOID&)Camera_Initialize_orig, Camera_Initialize_hk);
+    DETOUR_ATTACH_TRACED(Camera_Initialize_orig, Camera_Initialize_hk);
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "NamePlates.h"
 #include "GameClient.h"
 #include "Hooks.h"
+#include "Objects.h"
+#include "StartupTrace.h"
 #include <Windows.h>
 #include <Detours/detours.h>
 #include <algorithm>
@@ -102,8 +104,12 @@ static int CVarHandler_NameplateDistance(Console::CVar*, const char*, const char
 
 static int C_NamePlate_GetNamePlates(lua_State* L)
 {
-    lua_createtable(L, 0, 0);
     NamePlateVars& vars = lua_findorcreatevars(L);
+    int count = std::count_if(vars.nameplates.begin(), vars.nameplates.end(), [](const NamePlateEntry& entry) {
+        return (entry.flags & NamePlateFlag_Visible) && entry.guid;
+    });
+
+    lua_pushresulttable(L, 1, count, 0); // tbl
     int id = 1;
     for (NamePlateEntry& entry : vars.nameplates) {
         if ((entry.flags & NamePlateFlag_Visible) && entry.guid) {
@@ -111,13 +117,13 @@ static int C_NamePlate_GetNamePlates(lua_State* L)
             lua_rawseti(L, -2, id++);
         }
     }
+    lua_wipetail(L, -1, id);
     return 1;
 }
 
 static int C_NamePlate_GetNamePlateForUnit(lua_State* L)
 {
-    const char* token = luaL_checkstring(L, 1);
-    guid_t guid = ObjectMgr::GetGuidByUnitID(token);
+    guid_t guid = Objects::checkGuid(L, 1);
     if (!guid) return 0;
     NamePlateEntry* entry = getEntryByGuid(guid);
     if (!entry) return 0;
@@ -150,20 +156,19 @@ static void onUpdateCallback()
     lua_State* L = GetLuaState();
     NamePlateVars& vars = lua_findorcreatevars(L);
 
-    Player* player = ObjectMgr::GetPlayer();
-    VecXYZ posPlayer;
-    if (player) player->ToUnit()->vmt->GetPosition(player->ToUnit(), &posPlayer);
-
-    ObjectMgr::EnumObjects([&vars, player, &posPlayer](guid_t guid) -> bool {
-        Unit* unit = (Unit*)ObjectMgr::Get(guid, ObjectFlags_Unit);
-        if (!unit || !unit->nameplate) return true;
-        auto it = std::find_if(vars.nameplates.begin(), vars.nameplates.end(), [nameplate = unit->nameplate](const NamePlateEntry& entry) {
+    const Objects::Snapshot& objects = Objects::get();
+    bool hasPlayer = objects.player >= 0;
+    for (size_t slot = 0; slot < objects.size(); slot++) {
+        Frame* nameplate = objects.nameplates[slot];
+        if (!nameplate) continue;
+        guid_t guid = objects.guids[slot];
+        auto it = std::find_if(vars.nameplates.begin(), vars.nameplates.end(), [nameplate](const NamePlateEntry& entry) {
             return entry.nameplate == nameplate;
         });
         if (it == vars.nameplates.end()) {
             NamePlateEntry& entry = vars.nameplates.emplace_back();
             entry.guid = guid;
-            entry.nameplate = unit->nameplate;
+            entry.nameplate = nameplate;
             entry.updateId = vars.updateId;
         } else {
             if (it->guid != guid) {
@@ -173,14 +178,11 @@ static void onUpdateCallback()
             it->updateId = vars.updateId;
         }
 
-        if (player) {
-            VecXYZ unitPos;
-            unit->vmt->GetPosition(unit, &unitPos);
-            s_plateSort.push_back({ unit->nameplate, guid, posPlayer.distance(unitPos) });
+        if (hasPlayer) {
+            VecXYZ posPlayer = objects.positions[objects.player];
+            s_plateSort.push_back({ nameplate, guid, posPlayer.distance(objects.positions[slot]) });
         }
-        
-        return true;
-    });
+    }
 
     if (!s_plateSort.empty()) {
         std::sort(s_plateSort.begin(), s_plateSort.end(), [targetGuid = ObjectMgr::GetTargetGuid()](auto& a1, auto& a2) {
@@ -248,5 +250,5 @@ void NamePlates::initialize()
     Hooks::FrameScript::registerToken("nameplate", getTokenGuid, getTokenId);
     Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
 
-    DetourAttach(&(LPVOID&)PatchNamePlateLevelUpdate_orig, PatchNamePlateLevelUpdate_hk);
+    DETOUR_ATTACH_TRACED(PatchNamePlateLevelUpdate_orig, PatchNamePlateLevelUpdate_hk);
 }
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "Objects.h"
+#include "Hooks.h"
+#include "UnitGrid.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+static Objects::Snapshot s_snapshot;
+// (guid, slot) sorted by guid after each rebuild, storage is reused between frames
+static std::vector<std::pair<guid_t, int>> s_slots;
+
+/*
+    Keyed by string pointer: Lua strings are interned, so the same token passed from scripts hits the same entry
+    without hashing its characters. A collected string may leave its address to another one, token is compared on hit.
+    Only guid is cached, units are looked up on each use, object of the guid may be gone by then
+*/
+struct TokenMemo {
+    uint32_t generation;
+    guid_t guid;
+    char token[32];
+};
+
+// Entries are valid while their generation matches, so the map keeps its nodes between frames
+static std::unordered_map<const char*, TokenMemo> s_tokens;
+static uint32_t s_generation = 1;
+static std::vector<bool> s_invalidatingEvents; // by eventId
+
+/*
+    Unit handles: full userdata owned by script which requested it, so every GetHandle call gets its own handle
+    and unreferenced ones are collected as any other value. Slot is revalidated once per frame, unit is looked up on use
+*/
+struct UnitHandle {
+    uint32_t magic;
+    bool released;
+    guid_t guid;
+    uint32_t frame; // snapshot frame slot was resolved for
+    int slot;
+};
+
+static constexpr uint32_t UNIT_HANDLE_MAGIC = 0x444E4855; // "UHND"
+
+#define OBJECT_VISIBLE "OBJECT_VISIBLE"
+#define OBJECT_GONE "OBJECT_GONE"
+
+// Sorted guids of units visible in previous frame, diffed with new snapshot to find membership changes
+static std::vector<guid_t> s_visible;
+static int s_visibleEventId = -1;
+static int s_goneEventId = -1;
+
+static const char* s_invalidatingEventNames[] = {
+    "PLAYER_TARGET_CHANGED", "PLAYER_FOCUS_CHANGED", "UPDATE_MOUSEOVER_UNIT", "PLAYER_ENTERING_WORLD",
+    "PARTY_MEMBERS_CHANGED", "RAID_ROSTER_UPDATE", "UNIT_PET", "ARENA_OPPONENT_UPDATE",
+    "NAME_PLATE_UNIT_ADDED", "NAME_PLATE_UNIT_REMOVED", "UNIT_TARGET", "INSTANCE_ENCOUNTER_ENGAGE_UNIT",
+    "UNIT_ENTERED_VEHICLE", "UNIT_EXITED_VEHICLE",
+};
+
+// Built on first radius query of a frame
+static UnitGrid s_grid;
+static uint32_t s_gridFrame = 0;
+
+const Objects::Snapshot& Objects::get() { return s_snapshot; }
+
+int Objects::find(guid_t guid)
+{
+    if (!guid) return -1;
+    auto it = std::lower_bound(s_slots.begin(), s_slots.end(), std::make_pair(guid, INT_MIN));
+    return it != s_slots.end() && it->first == guid ? it->second : -1;
+}
+
+int Objects::find(const char* unitId) { return find(getGuid(unitId)); }
+
+void Objects::queryRadius(float x, float y, float radius, uint32_t requiredFlags, std::vector<int>& out)
+{
+    if (s_gridFrame != s_snapshot.frame) {
+        s_grid.build(s_snapshot.positions);
+        s_gridFrame = s_snapshot.frame;
+    }
+    s_grid.query(s_snapshot.positions, s_snapshot.flags, x, y, radius, requiredFlags, out);
+}
+
+static bool endsWithTarget(const char* token, size_t& len)
+{
+    static constexpr char suffix[] = "target";
+    constexpr size_t suffixLen = std::size(suffix) - 1;
+    if (len < suffixLen) return false;
+    for (size_t i = 0; i < suffixLen; i++)
+        if (std::tolower((unsigned char)token[len - suffixLen + i]) != suffix[i]) return false;
+    len -= suffixLen;
+    return true;
+}
+
+/*
+    UNIT_TARGET is fired for units the client tracks, so "target", "targettarget" and "party1target" can be memoized.
+    Deeper chains as "party1targettarget" change with no event and are resolved on every call
+*/
+static bool isMemoizable(const char* token, size_t len)
+{
+    if (len >= sizeof(TokenMemo::token)) return false;
+    int depth = 0;
+    while (endsWithTarget(token, len)) depth++;
+    return depth <= (len ? 1 : 2);
+}
+
+static guid_t resolveToken(const char* unitId)
+{
+    // Hex guids would fill the map without bound
+    if (s_tokens.size() >= 1024) s_tokens.clear();
+    auto it = s_tokens.find(unitId);
+    if (it != s_tokens.end() && it->second.generation == s_generation && !strcmp(it->second.token, unitId))
+        return it->second.guid;
+
+    guid_t guid = ObjectMgr::String2Guid(unitId);
+    size_t len = strlen(unitId);
+    if (!isMemoizable(unitId, len)) return guid;
+    TokenMemo& memo = it != s_tokens.end() ? it->second : s_tokens[unitId];
+    memo.generation = s_generation;
+    memo.guid = guid;
+    memcpy(memo.token, unitId, len + 1);
+    return guid;
+}
+
+guid_t Objects::getGuid(const char* unitId)
+{
+    if (!unitId) return 0;
+    return resolveToken(unitId);
+}
+
+Unit* Objects::getUnit(const char* unitId)
+{
+    guid_t guid = getGuid(unitId);
+    return guid ? (Unit*)ObjectMgr::Get(guid, ObjectFlags_Unit) : NULL;
+}
+
+static UnitHandle* toHandle(lua_State* L, int idx)
+{
+    if (lua_type(L, idx) != LUA_TUSERDATA || lua_objlen(L, idx) != sizeof(UnitHandle)) return NULL;
+    UnitHandle* handle = (UnitHandle*)lua_touserdata(L, idx);
+    return handle->magic == UNIT_HANDLE_MAGIC ? handle : NULL;
+}
+
+void Objects::pushHandle(lua_State* L, guid_t guid)
+{
+    UnitHandle* handle = (UnitHandle*)lua_newuserdata(L, sizeof(UnitHandle));
+    handle->magic = UNIT_HANDLE_MAGIC;
+    handle->released = false;
+    handle->guid = guid;
+    handle->frame = s_snapshot.frame - 1;
+    handle->slot = -1;
+}
+
+bool Objects::releaseHandle(lua_State* L, int idx)
+{
+    UnitHandle* handle = toHandle(L, idx);
+    if (!handle || handle->released) return false;
+    handle->released = true;
+    return true;
+}
+
+// Released handles and non-handles give NULL
+static UnitHandle* validateHandle(lua_State* L, int idx)
+{
+    UnitHandle* handle = toHandle(L, idx);
+    if (!handle || handle->released) return NULL;
+    if (handle->frame != s_snapshot.frame) {
+        handle->frame = s_snapshot.frame;
+        handle->slot = Objects::find(handle->guid);
+    }
+    return handle;
+}
+
+guid_t Objects::toGuid(lua_State* L, int idx)
+{
+    if (lua_type(L, idx) == LUA_TUSERDATA) {
+        UnitHandle* handle = validateHandle(L, idx);
+        return handle ? handle->guid : 0;
+    }
+    return lua_type(L, idx) == LUA_TSTRING ? getGuid(lua_tostring(L, idx)) : 0;
+}
+
+int Objects::toSlot(lua_State* L, int idx)
+{
+    if (lua_type(L, idx) == LUA_TUSERDATA) {
+        UnitHandle* handle = validateHandle(L, idx);
+        return handle ? handle->slot : -1;
+    }
+    return lua_type(L, idx) == LUA_TSTRING ? find(lua_tostring(L, idx)) : -1;
+}
+
+guid_t Objects::checkGuid(lua_State* L, int idx)
+{
+    if (lua_type(L, idx) != LUA_TUSERDATA) luaL_checkstring(L, idx);
+    return toGuid(L, idx);
+}
+
+int Objects::checkSlot(lua_State* L, int idx)
+{
+    if (lua_type(L, idx) != LUA_TUSERDATA) luaL_checkstring(L, idx);
+    return toSlot(L, idx);
+}
+
+Unit* Objects::checkUnit(lua_State* L, int idx)
+{
+    if (lua_type(L, idx) == LUA_TUSERDATA) {
+        UnitHandle* handle = validateHandle(L, idx);
+        return handle && handle->slot >= 0 ? (Unit*)ObjectMgr::Get(handle->guid, ObjectFlags_Unit) : NULL;
+    }
+    return getUnit(luaL_checkstring(L, idx));
+}
+
+// Runs before dispatch, handlers of the event already see new tokens
+static bool invalidatingFilter(int eventId, lua_State*, int)
+{
+    if (eventId >= 0 && (size_t)eventId < s_invalidatingEvents.size() && s_invalidatingEvents[eventId])
+        s_generation++;
+    return true;
+}
+
+static int lua_openlibobjects(lua_State* L)
+{
+    s_invalidatingEvents.clear();
+    for (const char* name : s_invalidatingEventNames) {
+        int eventId = FrameScript::GetEventIdByName(name);
+        if (eventId < 0) continue;
+        if ((size_t)eventId >= s_invalidatingEvents.size()) s_invalidatingEvents.resize(eventId + 1);
+        s_invalidatingEvents[eventId] = true;
+    }
+    s_generation++;
+
+    // Everything is reported as visible to the new state
+    s_visible.clear();
+    s_visibleEventId = s_goneEventId = -1;
+    return 0;
+}
+
+static void clearSnapshot()
+{
+    Objects::Snapshot& s = s_snapshot;
+    for (auto* column : { &s.guids, &s.targets, &s.charms, &s.summons })
+        column->clear();
+    for (auto* column : { &s.flags, &s.flags2, &s.health, &s.maxHealth, &s.power, &s.maxPower, &s.factionTemplates })
+        column->clear();
+    s.positions.clear();
+    s.nameplates.clear();
+    s.player = -1;
+    s_slots.clear();
+}
+
+static void appendUnit(guid_t guid, Unit* unit)
+{
+    Objects::Snapshot& s = s_snapshot;
+    UnitEntry* entry = unit->entry;
+    uint32_t powerType = (entry->bytes0 >> 24) & 0xFF;
+    if (powerType >= std::size(entry->power)) powerType = 0;
+
+    VecXYZ pos;
+    unit->vmt->GetPosition(unit, &pos);
+
+    s_slots.emplace_back(guid, s.guids.size());
+    s.guids.push_back(guid);
+    s.positions.push_back(pos);
+    s.flags.push_back(entry->flags);
+    s.flags2.push_back(entry->flags2);
+    s.health.push_back(entry->health);
+    s.maxHealth.push_back(entry->maxHealth);
+    s.power.push_back(entry->power[powerType]);
+    s.maxPower.push_back(entry->maxPower[powerType]);
+    s.targets.push_back(entry->target);
+    s.factionTemplates.push_back(entry->factionTemplate);
+    s.charms.push_back(entry->charm);
+    s.summons.push_back(entry->summon);
+    s.nameplates.push_back(unit->nameplate);
+}
+
+static void fireMembershipEvent(const char* event, int& eventId, const std::vector<guid_t>& guids)
+{
+    lua_State* L = GetLuaState();
+    if (guids.empty() || !L) return;
+    if (eventId < 0) eventId = FrameScript::GetEventIdByName(event);
+    if (eventId < 0) return;
+    lua_pushstring(L, event); // event
+    lua_createtable(L, guids.size(), 0); // event, guids
+    for (size_t i = 0; i < guids.size(); i++) {
+        lua_pushguid(L, guids[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    FrameScript::FireEvent_inner(eventId, L, 2);
+    lua_pop(L, 2);
+}
+
+static void diffVisible()
+{
+    static std::vector<guid_t> s_current, s_appeared, s_gone;
+    s_current.clear();
+    for (auto& [guid, slot] : s_slots)
+        s_current.push_back(guid);
+    std::set_difference(s_current.begin(), s_current.end(), s_visible.begin(), s_visible.end(), std::back_inserter(s_appeared));
+    std::set_difference(s_visible.begin(), s_visible.end(), s_current.begin(), s_current.end(), std::back_inserter(s_gone));
+    s_visible.swap(s_current);
+
+    fireMembershipEvent(OBJECT_GONE, s_goneEventId, s_gone);
+    fireMembershipEvent(OBJECT_VISIBLE, s_visibleEventId, s_appeared);
+    s_appeared.clear();
+    s_gone.clear();
+}
+
+// Registered first, so every other OnUpdate callback and scripts of this frame see the same state
+static void onUpdateCallback()
+{
+    clearSnapshot();
+    s_snapshot.frame++;
+    s_generation++;
+    if (IsInWorld()) {
+        ObjectMgr::EnumUnits([](guid_t guid, Unit* unit) -> bool {
+            appendUnit(guid, unit);
+            return true;
+        });
+        std::sort(s_slots.begin(), s_slots.end());
+
+        if (Player* player = ObjectMgr::GetPlayer())
+            s_snapshot.player = Objects::find(player->entry->guid);
+    }
+    diffVisible();
+}
+
+void Objects::initialize()
+{
+    Hooks::FrameXML::registerLuaLib(lua_openlibobjects);
+    Hooks::FrameXML::registerEvent(OBJECT_VISIBLE);
+    Hooks::FrameXML::registerEvent(OBJECT_GONE);
+    Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
+    Hooks::FrameScript::registerEventFilter(invalidatingFilter);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include "GameClient.h"
+#include <vector>
+
+namespace Objects {
+// Units visible this frame, copied once at start of OnUpdate. Arrays are indexed by slot
+struct Snapshot {
+    std::vector<guid_t> guids;
+    std::vector<VecXYZ> positions;
+    std::vector<uint32_t> flags, flags2;
+    std::vector<uint32_t> health, maxHealth;
+    std::vector<uint32_t> power, maxPower; // of unit's display power type
+    std::vector<guid_t> targets;
+    std::vector<uint32_t> factionTemplates;
+    std::vector<guid_t> charms, summons;
+    std::vector<Frame*> nameplates;
+    int player = -1; // slot of active player
+    uint32_t frame = 0; // incremented on every rebuild
+
+    size_t size() const { return guids.size(); }
+};
+
+const Snapshot& get();
+// Slot of unit, -1 if it isn't in snapshot
+int find(guid_t guid);
+int find(const char* unitId);
+
+// Slots of units within radius of point on XY plane whose flags have all of requiredFlags set, appended to out
+void queryRadius(float x, float y, float radius, uint32_t requiredFlags, std::vector<int>& out);
+
+// Unit tokens resolved to guid once per frame, memo is also dropped when target, focus, group etc. change.
+// Unit is looked up on every call
+guid_t getGuid(const char* unitId);
+Unit* getUnit(const char* unitId);
+
+// Handles are userdata bound to guid until released or collected, resolved once per frame without string parsing
+void pushHandle(lua_State* L, guid_t guid);
+bool releaseHandle(lua_State* L, int idx);
+
+// Unit argument of API functions: unit token, hex guid or handle. to* return 0/-1/NULL, check* raise on wrong type
+guid_t toGuid(lua_State* L, int idx);
+int toSlot(lua_State* L, int idx);
+guid_t checkGuid(lua_State* L, int idx);
+int checkSlot(lua_State* L, int idx);
+Unit* checkUnit(lua_State* L, int idx);
+
+void initialize();
+}
\ No newline at end of file
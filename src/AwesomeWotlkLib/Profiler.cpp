@@ -0,0 +1,303 @@
+#include "Profiler.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include "StartupTrace.h"
+#include <Windows.h>
+#include <Detours/detours.h>
+#include <intrin.h>
+#include <bit>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Sampling every lua_pcall made by client (event handlers, OnUpdate and other scripts) with TSC.
+    Time is exclusive: nested calls are subtracted from caller and charged to their own addon.
+    Owner addon is taken from source chunk of called function, per-event cost is time of all
+    handlers called while event was dispatching.
+*/
+
+constexpr uint32_t PROFILER_MAX_DEPTH = 256;
+constexpr uint32_t PROFILER_MAX_MSB = 40;
+constexpr uint32_t PROFILER_NUM_BUCKETS = (PROFILER_MAX_MSB + 1) * 4;
+
+enum : int {
+    PROFILER_EVENT_ONUPDATE = -2,
+    PROFILER_EVENT_OTHER = -1,
+};
+
+// Log-linear histogram: 4 buckets per power of two, ~12% precision
+struct CostStats {
+    uint64_t cycles;
+    uint32_t calls;
+    uint32_t buckets[PROFILER_NUM_BUCKETS];
+
+    static uint32_t bucketOf(uint64_t cycles)
+    {
+        if (cycles < 4) return (uint32_t)cycles;
+        uint32_t msb = std::bit_width(cycles) - 1;
+        if (msb > PROFILER_MAX_MSB) return PROFILER_NUM_BUCKETS - 1;
+        return (msb - 1) * 4 + ((cycles >> (msb - 2)) & 3);
+    }
+
+    static uint64_t bucketMid(uint32_t bucket)
+    {
+        if (bucket < 4) return bucket;
+        uint32_t msb = bucket / 4 + 1;
+        uint64_t lower = (uint64_t)(4 + bucket % 4) << (msb - 2);
+        return lower + (1ull << (msb - 2)) / 2;
+    }
+
+    void add(uint64_t c)
+    {
+        cycles += c;
+        calls++;
+        buckets[bucketOf(c)]++;
+    }
+
+    uint64_t percentile(double p) const
+    {
+        uint64_t target = (uint64_t)(calls * p + 0.5);
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < PROFILER_NUM_BUCKETS; i++) {
+            sum += buckets[i];
+            if (sum >= target && sum) return bucketMid(i);
+        }
+        return 0;
+    }
+};
+
+struct ProfilerFrame {
+    uint64_t start;
+    uint64_t children;
+    uint16_t addon;
+};
+
+struct ChunkAddon {
+    uint32_t hash;
+    uint16_t addon;
+};
+
+static bool s_running = false;
+static bool s_attribution = false;
+static uint32_t s_depth = 0;
+static ProfilerFrame s_stack[PROFILER_MAX_DEPTH];
+
+static std::vector<std::string> s_addonNames;
+static std::unordered_map<std::string, uint16_t> s_addonIds;
+static std::unordered_map<const lua_TString*, ChunkAddon> s_chunkAddons;
+static std::vector<CostStats> s_addonStats;
+static std::unordered_map<int, CostStats> s_eventStats;
+
+static uint64_t s_startTsc;
+static LARGE_INTEGER s_startQpc;
+
+static bool consumePathPart(const char*& str, const char* part)
+{
+    const char* s = str;
+    for (; *part; part++, s++) {
+        char a = *s == '/' ? '\\' : tolower((unsigned char)*s);
+        char b = *part == '/' ? '\\' : tolower((unsigned char)*part);
+        if (a != b) return false;
+    }
+    str = s;
+    return true;
+}
+
+// "@Interface\AddOns\Foo\Bar.lua" -> "Foo", "@Interface\FrameXML\Bar.lua" -> "FrameXML"
+static std::string parseAddonName(const char* source)
+{
+    if (source[0] != '@') return "(string)";
+    source++;
+    if (!consumePathPart(source, "Interface\\")) return "(other)";
+    consumePathPart(source, "AddOns\\");
+    size_t len = strcspn(source, "\\/");
+    return len ? std::string(source, len) : "(other)";
+}
+
+static uint16_t getAddonId(const std::string& name)
+{
+    auto it = s_addonIds.find(name);
+    if (it != s_addonIds.end()) return it->second;
+    uint16_t id = s_addonNames.size();
+    s_addonNames.push_back(name);
+    s_addonIds[name] = id;
+    s_addonStats.emplace_back();
+    return id;
+}
+
+static uint16_t getChunkAddonId(const lua_TString* chunk)
+{
+    if (!chunk) return getAddonId("(C)");
+    auto it = s_chunkAddons.find(chunk);
+    // String could be collected and its memory reused by another one
+    if (it != s_chunkAddons.end() && it->second.hash == chunk->hash)
+        return it->second.addon;
+    uint16_t id = getAddonId(parseAddonName(chunk->str()));
+    s_chunkAddons[chunk] = { chunk->hash, id };
+    return id;
+}
+
+uint16_t Profiler::getCurrentAddon()
+{
+    static uint16_t s_noneId = getAddonId("(none)");
+    return s_depth ? s_stack[s_depth - 1].addon : s_noneId;
+}
+
+uint16_t Profiler::getRunningAddon()
+{
+    lua_State* L = s_depth ? GetLuaState() : NULL;
+    lua_TString* chunk = L ? lua_getrunningchunk(L) : NULL;
+    return chunk ? getChunkAddonId(chunk) : getCurrentAddon();
+}
+
+const char* Profiler::getAddonName(uint16_t id) { return id < s_addonNames.size() ? s_addonNames[id].c_str() : NULL; }
+void Profiler::setAttribution(bool enabled) { s_attribution = enabled; }
+
+static int getCurrentEvent()
+{
+    int eventId = Hooks::FrameScript::getFiringEvent();
+    if (eventId >= 0) return eventId;
+    return Hooks::FrameScript::isFiringOnUpdate() ? PROFILER_EVENT_ONUPDATE : PROFILER_EVENT_OTHER;
+}
+
+static int(*lua_pcall_orig)(lua_State* L, int argn, int retn, int eh) = (decltype(lua_pcall_orig))0x0084EC50;
+static int lua_pcall_hk(lua_State* L, int argn, int retn, int eh)
+{
+    if ((!s_running && !s_attribution) || s_depth >= PROFILER_MAX_DEPTH)
+        return lua_pcall_orig(L, argn, retn, eh);
+
+    ProfilerFrame& frame = s_stack[s_depth++];
+    frame.addon = getChunkAddonId(lua_tochunk(L, -(argn + 1)));
+    frame.children = 0;
+    frame.start = __rdtsc();
+
+    int result = lua_pcall_orig(L, argn, retn, eh);
+
+    uint64_t total = __rdtsc() - frame.start;
+    s_depth--;
+    if (s_running) {
+        s_addonStats[frame.addon].add(total - frame.children);
+        if (s_depth) s_stack[s_depth - 1].children += total;
+        else s_eventStats[getCurrentEvent()].add(total);
+    }
+    return result;
+}
+
+static double getCyclesPerMs()
+{
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    double ms = (now.QuadPart - s_startQpc.QuadPart) * 1000.0 / freq.QuadPart;
+    return ms > 0 ? (__rdtsc() - s_startTsc) / ms : 1.0;
+}
+
+static void pushCostStats(lua_State* L, const char* name, const CostStats& stats, double cyclesPerMs)
+{
+    lua_getfield(L, -1, name); // tbl, entry
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1); // tbl
+        lua_createtable(L, 0, 5); // tbl, entry
+        lua_pushvalue(L, -1); // tbl, entry, entry
+        lua_setfield(L, -3, name); // tbl, entry
+    }
+    lua_pushnumber(L, stats.cycles / cyclesPerMs);
+    lua_setfield(L, -2, "time");
+    lua_pushnumber(L, stats.calls);
+    lua_setfield(L, -2, "calls");
+    lua_pushnumber(L, stats.percentile(0.50) / cyclesPerMs);
+    lua_setfield(L, -2, "p50");
+    lua_pushnumber(L, stats.percentile(0.95) / cyclesPerMs);
+    lua_setfield(L, -2, "p95");
+    lua_pushnumber(L, stats.percentile(0.99) / cyclesPerMs);
+    lua_setfield(L, -2, "p99");
+    lua_pop(L, 1); // tbl
+}
+
+static void resetStats()
+{
+    for (CostStats& stats : s_addonStats)
+        stats = {};
+    s_eventStats.clear();
+    s_startTsc = __rdtsc();
+    QueryPerformanceCounter(&s_startQpc);
+}
+
+static int C_Profiler_Start(lua_State* L)
+{
+    if (!s_running) resetStats();
+    s_running = true;
+    return 0;
+}
+
+static int C_Profiler_Stop(lua_State* L)
+{
+    s_running = false;
+    return 0;
+}
+
+static int C_Profiler_Reset(lua_State* L)
+{
+    resetStats();
+    return 0;
+}
+
+static int C_Profiler_IsRunning(lua_State* L)
+{
+    if (!s_running) return 0;
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int C_Profiler_GetAddOnStats(lua_State* L)
+{
+    double cyclesPerMs = getCyclesPerMs();
+    lua_pushresulttable(L, 1, 0, s_addonNames.size());
+    for (size_t i = 0; i < s_addonNames.size(); i++)
+        if (s_addonStats[i].calls)
+            pushCostStats(L, s_addonNames[i].c_str(), s_addonStats[i], cyclesPerMs);
+    return 1;
+}
+
+static int C_Profiler_GetEventStats(lua_State* L)
+{
+    double cyclesPerMs = getCyclesPerMs();
+    lua_pushresulttable(L, 1, 0, s_eventStats.size());
+    for (auto& [eventId, stats] : s_eventStats) {
+        const char* name = eventId == PROFILER_EVENT_ONUPDATE ? "OnUpdate" : eventId == PROFILER_EVENT_OTHER ? "(other)" : FrameScript::GetEventNameById(eventId);
+        if (name) pushCostStats(L, name, stats, cyclesPerMs);
+    }
+    return 1;
+}
+
+static int lua_openlibprofiler(lua_State* L)
+{
+    // Previous state is gone, nothing is running inside it
+    s_depth = 0;
+    s_chunkAddons.clear();
+
+    luaL_Reg methods[] = {
+        {"Start", C_Profiler_Start},
+        {"Stop", C_Profiler_Stop},
+        {"Reset", C_Profiler_Reset},
+        {"IsRunning", C_Profiler_IsRunning},
+        {"GetAddOnStats", C_Profiler_GetAddOnStats},
+        {"GetEventStats", C_Profiler_GetEventStats},
+    };
+
+    lua_createtable(L, 0, std::size(methods));
+    for (size_t i = 0; i < std::size(methods); i++) {
+        lua_pushcfunction(L, methods[i].func);
+        lua_setfield(L, -2, methods[i].name);
+    }
+    lua_setglobal(L, "C_Profiler");
+    return 0;
+}
+
+void Profiler::initialize()
+{
+    Hooks::FrameXML::registerLuaLib(lua_openlibprofiler);
+    DETOUR_ATTACH_TRACED(lua_pcall_orig, lua_pcall_hk);
+}
\ No newline at end of file
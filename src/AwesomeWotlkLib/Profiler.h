@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Profiler {
+// Addon owning running script, "(none)" outside of scripts. Requires profiler running or attribution enabled
+uint16_t getCurrentAddon();
+// Addon owning source of innermost running lua function, so direct calls into code of other addon are told apart.
+// Falls back to getCurrentAddon outside of lua functions
+uint16_t getRunningAddon();
+const char* getAddonName(uint16_t id);
+// Keeps track of current addon while profiler is stopped
+void setAttribution(bool enabled);
+
+void initialize();
+}
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "SlabPool.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+using namespace SlabPool;
+
+constexpr uint8_t POOL_NO_CLASS = 0xFF;
+
+static const uint16_t s_classSizes[] = { 8, 16, 24, 32, 40, 48, 64, 80, 96, 128, 160, 192, 256 };
+static_assert(std::size(s_classSizes) == NUM_CLASSES);
+
+namespace {
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct SizeClass {
+    FreeBlock* freeList;
+    char* bumpCur;
+    char* bumpEnd;
+    uint32_t usedBlocks;
+    uint32_t totalBlocks;
+    uint32_t pages;
+};
+}
+
+static char* s_region = NULL;
+static size_t s_numPages = 0;
+static size_t s_committedPages = 0;
+static CommitPage s_commit = NULL;
+static std::vector<uint8_t> s_pageClass;
+static uint8_t s_sizeToClass[MAX_BLOCK / 8 + 1];
+static SizeClass s_classes[NUM_CLASSES];
+static Stats s_stats;
+static bool s_enabled = false;
+
+static Fallback s_fallback = NULL;
+static void* s_fallbackUd = NULL;
+
+static inline uint8_t classOfSize(size_t size) { return size <= MAX_BLOCK ? s_sizeToClass[(size + 7) >> 3] : POOL_NO_CLASS; }
+static inline uint8_t classOfBlock(const void* ptr) { return s_pageClass[pageOf(ptr)]; }
+
+static bool newPage(uint8_t cls)
+{
+    if (!s_region || s_committedPages >= s_numPages) return false;
+    char* page = s_region + s_committedPages * PAGE_SIZE;
+    if (!s_commit(page, PAGE_SIZE)) return false;
+    s_pageClass[s_committedPages++] = cls;
+
+    SizeClass& sc = s_classes[cls];
+    sc.bumpCur = page;
+    sc.bumpEnd = page + PAGE_SIZE - PAGE_SIZE % s_classSizes[cls];
+    sc.totalBlocks += PAGE_SIZE / s_classSizes[cls];
+    sc.pages++;
+    return true;
+}
+
+static void* poolAlloc(uint8_t cls)
+{
+    SizeClass& sc = s_classes[cls];
+    void* ptr;
+    if (sc.freeList) {
+        ptr = sc.freeList;
+        sc.freeList = sc.freeList->next;
+    } else {
+        if (sc.bumpCur == sc.bumpEnd && !newPage(cls))
+            return NULL;
+        ptr = sc.bumpCur;
+        sc.bumpCur += s_classSizes[cls];
+    }
+    sc.usedBlocks++;
+    return ptr;
+}
+
+static void poolFree(void* ptr)
+{
+    SizeClass& sc = s_classes[classOfBlock(ptr)];
+    FreeBlock* block = (FreeBlock*)ptr;
+    block->next = sc.freeList;
+    sc.freeList = block;
+    sc.usedBlocks--;
+}
+
+static void* allocBlock(size_t size)
+{
+    uint8_t cls = classOfSize(size);
+    if (s_enabled && cls != POOL_NO_CLASS)
+        if (void* ptr = poolAlloc(cls)) {
+            s_stats.pooledBytes += size;
+            return ptr;
+        }
+    void* ptr = s_fallback(s_fallbackUd, NULL, 0, size);
+    if (ptr) s_stats.fallbackBytes += size;
+    return ptr;
+}
+
+static void freeBlock(void* ptr, size_t size)
+{
+    if (isPooled(ptr)) {
+        poolFree(ptr);
+        s_stats.pooledBytes -= size;
+    } else {
+        s_fallback(s_fallbackUd, ptr, size, 0);
+        s_stats.fallbackBytes -= size;
+    }
+}
+
+void SlabPool::initialize(char* region, size_t regionSize, CommitPage commit)
+{
+    for (size_t size = 0, cls = 0; size <= MAX_BLOCK; size += 8) {
+        while (s_classSizes[cls] < size) cls++;
+        s_sizeToClass[size >> 3] = (uint8_t)cls;
+    }
+    s_region = region;
+    s_numPages = region ? regionSize / PAGE_SIZE : 0;
+    s_commit = commit;
+    s_pageClass.assign(s_numPages, POOL_NO_CLASS);
+}
+
+void SlabPool::setFallback(Fallback fallback, void* ud, size_t liveBytes)
+{
+    s_fallback = fallback;
+    s_fallbackUd = ud;
+    s_stats.liveBytes = s_stats.fallbackBytes = liveBytes;
+    s_stats.pooledBytes = 0;
+    s_stats.allocs = s_stats.frees = 0;
+}
+
+void SlabPool::setEnabled(bool enabled)
+{
+    s_enabled = enabled && s_region;
+}
+
+void* SlabPool::alloc(void* ptr, size_t osize, size_t nsize)
+{
+    if (nsize == 0) {
+        if (ptr) {
+            freeBlock(ptr, osize);
+            s_stats.liveBytes -= osize;
+            s_stats.frees++;
+        }
+        return NULL;
+    }
+
+    if (!ptr) {
+        void* result = allocBlock(nsize);
+        if (result) {
+            s_stats.liveBytes += nsize;
+            s_stats.allocs++;
+        }
+        return result;
+    }
+
+    // Realloc. Lua expects shrinking to never fail, block which can't be moved then stays where it is
+    bool pooled = isPooled(ptr);
+    if (pooled && classOfBlock(ptr) == classOfSize(nsize)) {
+        s_stats.pooledBytes += nsize - osize;
+    } else if (!pooled && classOfSize(nsize) == POOL_NO_CLASS) {
+        void* result = s_fallback(s_fallbackUd, ptr, osize, nsize);
+        if (!result && nsize > osize) return NULL;
+        s_stats.fallbackBytes += nsize - osize;
+        if (result) ptr = result;
+    } else if (void* result = allocBlock(nsize)) {
+        memcpy(result, ptr, (std::min)(osize, nsize));
+        freeBlock(ptr, osize);
+        ptr = result;
+    } else {
+        if (nsize > osize) return NULL;
+        (pooled ? s_stats.pooledBytes : s_stats.fallbackBytes) += nsize - osize;
+    }
+    s_stats.liveBytes += nsize - osize;
+    return ptr;
+}
+
+bool SlabPool::isPooled(const void* ptr)
+{
+    return ptr >= s_region && ptr < s_region + s_committedPages * PAGE_SIZE;
+}
+
+size_t SlabPool::pageOf(const void* ptr)
+{
+    return ((const char*)ptr - s_region) / PAGE_SIZE;
+}
+
+size_t SlabPool::blockOf(const void* ptr)
+{
+    return ((const char*)ptr - s_region) % PAGE_SIZE / s_classSizes[classOfBlock(ptr)];
+}
+
+uint32_t SlabPool::blocksPerPage(size_t page)
+{
+    return (uint32_t)(PAGE_SIZE / s_classSizes[s_pageClass[page]]);
+}
+
+Stats SlabPool::getStats()
+{
+    size_t pooledCapacity = 0;
+    for (size_t i = 0; i < NUM_CLASSES; i++)
+        pooledCapacity += (size_t)s_classes[i].usedBlocks * s_classSizes[i];
+
+    Stats stats = s_stats;
+    stats.committedBytes = s_committedPages * PAGE_SIZE;
+    stats.fragmentation = stats.committedBytes ? 1.0 - (double)stats.pooledBytes / stats.committedBytes : 0.0;
+    stats.internalFragmentation = pooledCapacity ? 1.0 - (double)stats.pooledBytes / pooledCapacity : 0.0;
+    return stats;
+}
+
+ClassStats SlabPool::getClassStats(size_t cls)
+{
+    const SizeClass& sc = s_classes[cls];
+    return { s_classSizes[cls], sc.usedBlocks, sc.totalBlocks, sc.pages };
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Size-class slab pool behind the lua allocator. Small blocks (strings, tables, closures, upvalues) are
+    served from slabs carved out of one reserved region, anything bigger or not fitting into region goes
+    to fallback allocator. Blocks allocated before fallback was set are recognized by address and returned
+    to it as well. Region pages are committed through page source passed in, so pool doesn't depend on OS
+    and is also built on host by tools/LuaPoolReplay.
+*/
+namespace SlabPool {
+constexpr size_t PAGE_SIZE = 64 * 1024;
+constexpr size_t MAX_BLOCK = 256;
+constexpr size_t NUM_CLASSES = 13;
+
+// Makes page of reserved region usable, false if it can't
+using CommitPage = bool (*)(void* page, size_t size);
+// lua_Alloc
+using Fallback = void* (*)(void* ud, void* ptr, size_t osize, size_t nsize);
+
+struct Stats {
+    size_t liveBytes; // requested by lua
+    size_t pooledBytes; // requested and served by pool
+    size_t fallbackBytes; // requested and served by fallback allocator
+    size_t committedBytes;
+    uint32_t allocs;
+    uint32_t frees;
+    double fragmentation; // share of committed pool memory not holding live data: free blocks, tails of blocks, untouched page parts
+    double internalFragmentation; // same but only for rounding blocks up to their class size
+};
+
+struct ClassStats {
+    uint16_t size;
+    uint32_t used; // blocks
+    uint32_t total;
+    uint32_t pages;
+};
+
+// Region is only reserved, pool without region serves nothing. Call once before anything else
+void initialize(char* region, size_t regionSize, CommitPage commit);
+// Blocks allocated so far by fallback allocator, liveBytes in total, are still freed through it
+void setFallback(Fallback fallback, void* ud, size_t liveBytes);
+// Disabled pool still frees and reallocs its blocks, new ones go to fallback allocator
+void setEnabled(bool enabled);
+
+// lua_Alloc semantics, shrinking never fails
+void* alloc(void* ptr, size_t osize, size_t nsize);
+
+// Page index and block index within page of pooled block, e.g. for side tables
+bool isPooled(const void* ptr);
+size_t pageOf(const void* ptr);
+size_t blockOf(const void* ptr);
+uint32_t blocksPerPage(size_t page);
+
+Stats getStats();
+ClassStats getClassStats(size_t cls);
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "StartupTrace.h"
+#include <Detours/detours.h>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Timestamps of startup steps: module initialization, hook installation and first run of hooks
+    which are part of getting to login screen and into world. Report is written to
+    Logs\StartupTrace.csv and compared to the one left by previous run.
+*/
+
+constexpr double STARTUP_REGRESSION_RATIO = 1.25;
+constexpr double STARTUP_REGRESSION_MIN_MS = 1.0;
+
+struct StartupStep {
+    const char* name;
+    int64_t start;
+    int64_t end;
+};
+
+static bool s_finished = false;
+static LARGE_INTEGER s_freq;
+static LARGE_INTEGER s_attach;
+static double s_processToAttachMs = 0.0;
+static std::vector<StartupStep> s_steps;
+static std::unordered_map<std::string, double> s_previous;
+
+static double toMs(int64_t ticks) { return ticks * 1000.0 / s_freq.QuadPart; }
+
+void StartupTrace::record(const char* name, int64_t start, int64_t end)
+{
+    if (!s_finished) s_steps.push_back({ name, start, end });
+}
+
+LONG StartupTrace::detourAttach(PVOID* ppPointer, PVOID pDetour, const char* name)
+{
+    Scope scope(name);
+    return DetourAttach(ppPointer, pDetour);
+}
+
+static void loadPrevious()
+{
+    FILE* file;
+    if (fopen_s(&file, "Logs\\StartupTrace.csv", "r") || !file) return;
+    char line[256];
+    fgets(line, sizeof(line), file); // header
+    while (fgets(line, sizeof(line), file)) {
+        // name,start_ms,duration_ms,...
+        char* comma = strchr(line, ',');
+        if (!comma) continue;
+        char* duration = strchr(comma + 1, ',');
+        if (!duration) continue;
+        s_previous[std::string(line, comma)] = atof(duration + 1);
+    }
+    fclose(file);
+}
+
+static void writeReport()
+{
+    CreateDirectoryA("Logs", NULL);
+    FILE* file;
+    if (fopen_s(&file, "Logs\\StartupTrace.csv", "w") || !file) return;
+
+    fprintf(file, "name,start_ms,duration_ms,previous_ms,regression\n");
+    fprintf(file, "ProcessToAttach,0.000,%.3f,", s_processToAttachMs);
+    auto previous = s_previous.find("ProcessToAttach");
+    if (previous != s_previous.end()) fprintf(file, "%.3f,", previous->second);
+    else fprintf(file, ",");
+    fprintf(file, "\n");
+
+    for (const StartupStep& step : s_steps) {
+        double start = toMs(step.start - s_attach.QuadPart);
+        double duration = toMs(step.end - step.start);
+        fprintf(file, "%s,%.3f,%.3f,", step.name, start, duration);
+        auto it = s_previous.find(step.name);
+        if (it != s_previous.end()) {
+            bool regression = duration > it->second * STARTUP_REGRESSION_RATIO && duration - it->second > STARTUP_REGRESSION_MIN_MS;
+            fprintf(file, "%.3f,%s", it->second, regression ? "1" : "0");
+        } else {
+            fprintf(file, ",");
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+}
+
+void StartupTrace::report()
+{
+    if (!s_finished) writeReport();
+}
+
+void StartupTrace::finish()
+{
+    if (s_finished) return;
+    writeReport();
+    s_finished = true;
+    s_steps.clear();
+    s_steps.shrink_to_fit();
+}
+
+void StartupTrace::initialize()
+{
+    QueryPerformanceFrequency(&s_freq);
+    QueryPerformanceCounter(&s_attach);
+
+    FILETIME creation, exit, kernel, user, now;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        GetSystemTimeAsFileTime(&now);
+        ULARGE_INTEGER c = { creation.dwLowDateTime, creation.dwHighDateTime };
+        ULARGE_INTEGER n = { now.dwLowDateTime, now.dwHighDateTime };
+        s_processToAttachMs = (n.QuadPart - c.QuadPart) / 10000.0; // 100ns units
+    }
+    loadPrevious();
+}
\ No newline at end of file
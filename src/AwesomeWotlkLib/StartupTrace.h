@@ -0,0 +1,31 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+
+namespace StartupTrace {
+// Records duration of a named step, name must outlive the trace (string literal)
+void record(const char* name, int64_t start, int64_t end);
+LONG detourAttach(PVOID* ppPointer, PVOID pDetour, const char* name);
+// Writes report of steps recorded so far
+void report();
+// Last startup step: writes report, nothing is recorded afterwards
+void finish();
+void initialize();
+
+class Scope {
+public:
+    Scope(const char* name) : m_name(name) { QueryPerformanceCounter(&m_start); }
+    ~Scope()
+    {
+        LARGE_INTEGER end;
+        QueryPerformanceCounter(&end);
+        record(m_name, m_start.QuadPart, end.QuadPart);
+    }
+
+private:
+    const char* m_name;
+    LARGE_INTEGER m_start;
+};
+}
+
+#define DETOUR_ATTACH_TRACED(orig, hook) StartupTrace::detourAttach(&(LPVOID&)orig, hook, #hook)
\ No newline at end of file
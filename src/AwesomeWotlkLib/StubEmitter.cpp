@@ -0,0 +1,160 @@
+#include "StubEmitter.h"
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+constexpr size_t STUB_ARENA_SIZE = 4096;
+constexpr size_t STUB_ALIGN = 16;
+
+namespace {
+struct Writer {
+    uint8_t* out;
+    size_t size;
+
+    void byte(uint8_t b)
+    {
+        if (out) out[size] = b;
+        size++;
+    }
+
+    void dword(uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            byte((uint8_t)(v >> (i * 8)));
+    }
+
+    // mod r/m with 8 or 32 bit displacement, esp base needs sib
+    void modrm(uint8_t op, StubEmitter::Reg reg, int32_t disp)
+    {
+        bool disp8 = disp >= -128 && disp <= 127;
+        byte((disp8 ? 0x40 : 0x80) | (op << 3) | reg);
+        if (reg == StubEmitter::Esp) byte(0x24);
+        if (disp8) byte((uint8_t)disp);
+        else dword(disp);
+    }
+
+    void rel32(uintptr_t base, uintptr_t target)
+    {
+        dword((uint32_t)(target - (base + size + 4)));
+    }
+};
+}
+
+size_t StubEmitter::encode(const Desc& desc, uintptr_t base, uint8_t* out)
+{
+    Writer w = { out, 0 };
+    uint32_t pushed = 0;
+
+    for (uint8_t b : desc.prologue)
+        w.byte(b);
+
+    // Slot for resume address, lea keeps flags untouched: lea esp, [esp - 4]
+    if (desc.resume == Resume::Returned) {
+        w.byte(0x8D);
+        w.byte(0x64);
+        w.byte(0x24);
+        w.byte(0xFC);
+        pushed += 4;
+    }
+
+    for (Reg reg : { Eax, Ecx, Edx })
+        if (desc.save & (1 << reg)) {
+            w.byte(0x50 + reg); // push reg
+            pushed += 4;
+        }
+    if (desc.save & SaveFlags) {
+        w.byte(0x9C); // pushfd
+        pushed += 4;
+    }
+    uint32_t saved = pushed;
+
+    for (size_t i = desc.args.size(); i-- > 0;) {
+        const Arg& arg = desc.args[i];
+        int32_t disp = arg.reg == Esp ? arg.disp + pushed : arg.disp;
+        switch (arg.kind) {
+        case Arg::Value:
+            w.byte(0x50 + arg.reg); // push reg
+            break;
+        case Arg::Memory:
+            w.byte(0xFF); // push dword [reg + disp]
+            w.modrm(6, arg.reg, disp);
+            break;
+        case Arg::Address:
+            // push reg; add dword [esp], disp - no scratch register needed
+            w.byte(0x50 + arg.reg);
+            if (disp) {
+                bool disp8 = disp >= -128 && disp <= 127;
+                w.byte(disp8 ? 0x83 : 0x81);
+                w.byte(0x04);
+                w.byte(0x24);
+                if (disp8) w.byte((uint8_t)disp);
+                else w.dword(disp);
+            }
+            break;
+        case Arg::Immediate:
+            w.byte(0x68); // push imm32
+            w.dword(arg.disp);
+            break;
+        }
+        pushed += 4;
+    }
+
+    w.byte(0xE8); // call rel32
+    w.rel32(base, (uintptr_t)desc.callback);
+
+    uint32_t argsSize = pushed - saved;
+    if (argsSize) {
+        w.byte(argsSize < 128 ? 0x83 : 0x81); // add esp, imm
+        w.byte(0xC4);
+        if (argsSize < 128) w.byte((uint8_t)argsSize);
+        else w.dword(argsSize);
+    }
+
+    if (desc.resume == Resume::Returned) {
+        w.byte(0x89); // mov [esp + slot], eax
+        w.modrm(0, Esp, saved - 4);
+    }
+
+    if (desc.save & SaveFlags)
+        w.byte(0x9D); // popfd
+    for (Reg reg : { Edx, Ecx, Eax })
+        if (desc.save & (1 << reg))
+            w.byte(0x58 + reg); // pop reg
+
+    switch (desc.resume) {
+    case Resume::Return:
+    case Resume::Returned:
+        w.byte(0xC3); // ret
+        break;
+    case Resume::Jump:
+        w.byte(0xE9); // jmp rel32
+        w.rel32(base, desc.target);
+        break;
+    case Resume::JumpIndirect:
+        w.byte(0xFF); // jmp dword [target]
+        w.byte(0x25);
+        w.dword((uint32_t)desc.target);
+        break;
+    }
+    return w.size;
+}
+
+#ifdef _WIN32 // Encoder alone builds anywhere to be checked with a disassembler
+static uint8_t* s_arena = NULL;
+static size_t s_arenaUsed = 0;
+
+void* StubEmitter::emit(const Desc& desc)
+{
+    if (!s_arena)
+        s_arena = (uint8_t*)VirtualAlloc(NULL, STUB_ARENA_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!s_arena) return NULL;
+
+    size_t size = encode(desc, 0, NULL);
+    if (s_arenaUsed + size > STUB_ARENA_SIZE) return NULL;
+    uint8_t* stub = s_arena + s_arenaUsed;
+    encode(desc, (uintptr_t)stub, stub);
+    s_arenaUsed += (size + STUB_ALIGN - 1) & ~(STUB_ALIGN - 1);
+    FlushInstructionCache(GetCurrentProcess(), stub, size);
+    return stub;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    Generates thunks for mid-function hooks. Callback is plain cdecl function, so callee-saved
+    registers are kept by the callback itself and thunk only saves caller-saved registers which
+    original code reads after resume point, instead of pushad/pushfd round trip.
+*/
+namespace StubEmitter {
+enum Reg : uint8_t { Eax = 0, Ecx, Edx, Ebx, Esp, Ebp, Esi, Edi };
+
+enum : uint32_t {
+    SaveEax = 1 << Eax,
+    SaveEcx = 1 << Ecx,
+    SaveEdx = 1 << Edx,
+    SaveFlags = 1 << 8,
+};
+
+struct Arg {
+    enum Kind : uint8_t {
+        Value, // reg
+        Memory, // [reg + disp]
+        Address, // reg + disp
+        Immediate, // disp
+    };
+    Kind kind;
+    Reg reg;
+    int32_t disp;
+};
+
+// Esp based arguments are relative to esp at thunk entry after prologue
+inline Arg argValue(Reg reg) { return { Arg::Value, reg, 0 }; }
+inline Arg argMemory(Reg reg, int32_t disp) { return { Arg::Memory, reg, disp }; }
+inline Arg argAddress(Reg reg, int32_t disp) { return { Arg::Address, reg, disp }; }
+inline Arg argImmediate(uint32_t value) { return { Arg::Immediate, Eax, (int32_t)value }; }
+
+enum class Resume : uint8_t {
+    Return, // ret
+    Jump, // jmp target
+    JumpIndirect, // jmp [target], e.g. pointer to detours trampoline
+    Returned, // jmp to address returned by callback
+};
+
+struct Desc {
+    std::vector<uint8_t> prologue; // raw instructions executed first, e.g. epilogue overwritten by detour
+    uint32_t save; // Save* flags
+    const void* callback;
+    std::vector<Arg> args; // in callback parameter order
+    Resume resume;
+    uintptr_t target;
+};
+
+// Encodes thunk as if it was placed at base, returns its size. Doesn't write anything if out is NULL
+size_t encode(const Desc& desc, uintptr_t base, uint8_t* out);
+// Encodes thunk into executable memory, NULL on failure
+void* emit(const Desc& desc);
+}
\ No newline at end of file
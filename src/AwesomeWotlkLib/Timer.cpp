@@ -0,0 +1,200 @@
+#include "Timer.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include "TimerWheel.h"
+#include <algorithm>
+#include <vector>
+
+#define TIMER_CALLBACKS "C_Timer_callbacks"
+#define TIMER_HANDLES "C_Timer_handles"
+#define TIMER_HANDLE_MT "C_Timer_handle_mt"
+
+// TimerWheel user data
+enum : uint32_t {
+    TimerFlag_HasHandle = (1 << 0),
+};
+
+struct TimerHandle {
+    uint32_t node;
+    uint32_t id;
+};
+
+static std::vector<TimerWheel::Due> s_due; // node may be reused by the time it's fired
+static LARGE_INTEGER s_startTime, s_frequency;
+
+static uint32_t getTick()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint32_t)((now.QuadPart - s_startTime.QuadPart) * 1000 / s_frequency.QuadPart / TimerWheel::TICK_MS);
+}
+
+static void releaseCallback(lua_State* L, uint32_t id, bool withHandle)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, TIMER_CALLBACKS); // callbacks
+    lua_pushnil(L); // callbacks, nil
+    lua_rawseti(L, -2, id); // callbacks
+    lua_pop(L, 1);
+    if (withHandle) {
+        lua_getfield(L, LUA_REGISTRYINDEX, TIMER_HANDLES); // handles
+        lua_pushnil(L); // handles, nil
+        lua_rawseti(L, -2, id); // handles
+        lua_pop(L, 1);
+    }
+}
+
+static void invokeTimer(lua_State* L, uint32_t id, bool withHandle)
+{
+    int top = lua_gettop(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, GetLuaRefErrorHandler()); // eh
+    lua_getfield(L, LUA_REGISTRYINDEX, TIMER_CALLBACKS); // eh, callbacks
+    lua_rawgeti(L, -1, id); // eh, callbacks, func
+    if (withHandle) {
+        lua_getfield(L, LUA_REGISTRYINDEX, TIMER_HANDLES); // eh, callbacks, func, handles
+        lua_rawgeti(L, -1, id); // eh, callbacks, func, handles, handle
+        lua_insert(L, -2); // eh, callbacks, func, handle, handles
+        lua_pop(L, 1); // eh, callbacks, func, handle
+    }
+    if (lua_isfunction(L, top + 3))
+        lua_pcall(L, withHandle ? 1 : 0, 0, top + 1);
+    lua_settop(L, top);
+}
+
+static void onUpdateCallback()
+{
+    TimerWheel::advance(getTick(), s_due);
+    if (s_due.empty()) return;
+
+    lua_State* L = GetLuaState();
+    std::vector<TimerWheel::Due> due;
+    due.swap(s_due);
+    for (auto [idx, id] : due) {
+        // Timer was cancelled by earlier callback, its node may already hold a new timer
+        if (!TimerWheel::isActive(idx, id)) continue;
+
+        bool withHandle = TimerWheel::getUserData(idx) & TimerFlag_HasHandle;
+        invokeTimer(L, id, withHandle);
+
+        // Callback may cancel its own timer or create new ones
+        if (TimerWheel::isActive(idx, id) && !TimerWheel::rearm(idx))
+            releaseCallback(L, id, withHandle);
+    }
+    due.clear();
+    if (s_due.empty()) s_due.swap(due);
+}
+
+static void resetWheel()
+{
+    s_due.clear();
+    TimerWheel::reset(getTick());
+}
+
+static TimerHandle* lua_checktimerhandle(lua_State* L, int idx)
+{
+    luaL_checktype(L, idx, LUA_TUSERDATA);
+    return (TimerHandle*)lua_touserdata(L, idx);
+}
+
+// seconds, callback, iterations
+static int createTimer(lua_State* L, int iterations, bool withHandle)
+{
+    double seconds = luaL_checknumber(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+
+    uint32_t delay = seconds > 0 ? (uint32_t)((std::min)(seconds * 1000.0 / TimerWheel::TICK_MS, (double)TimerWheel::MAX_DELAY)) : 0;
+    auto [idx, id] = TimerWheel::schedule(delay, iterations, withHandle ? TimerFlag_HasHandle : 0);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, TIMER_CALLBACKS); // callbacks
+    lua_pushvalue(L, 2); // callbacks, func
+    lua_rawseti(L, -2, id); // callbacks
+    lua_pop(L, 1);
+
+    if (!withHandle) return 0;
+
+    TimerHandle* handle = (TimerHandle*)lua_newuserdata(L, sizeof(TimerHandle)); // handle
+    handle->node = idx;
+    handle->id = id;
+    lua_getfield(L, LUA_REGISTRYINDEX, TIMER_HANDLE_MT); // handle, mt
+    lua_setmetatable(L, -2); // handle
+    lua_getfield(L, LUA_REGISTRYINDEX, TIMER_HANDLES); // handle, handles
+    lua_pushvalue(L, -2); // handle, handles, handle
+    lua_rawseti(L, -2, id); // handle, handles
+    lua_pop(L, 1); // handle
+    return 1;
+}
+
+static int C_Timer_After(lua_State* L) { return createTimer(L, 1, false); }
+static int C_Timer_NewTimer(lua_State* L) { return createTimer(L, 1, true); }
+
+static int C_Timer_NewTicker(lua_State* L)
+{
+    int iterations = lua_isnoneornil(L, 3) ? -1 : (int)luaL_checknumber(L, 3);
+    return createTimer(L, iterations > 0 ? iterations : -1, true);
+}
+
+static int TimerHandle_Cancel(lua_State* L)
+{
+    TimerHandle* handle = lua_checktimerhandle(L, 1);
+    if (!TimerWheel::isActive(handle->node, handle->id)) return 0;
+    TimerWheel::cancel(handle->node);
+    releaseCallback(L, handle->id, true);
+    return 0;
+}
+
+static int TimerHandle_IsCancelled(lua_State* L)
+{
+    TimerHandle* handle = lua_checktimerhandle(L, 1);
+    if (TimerWheel::isActive(handle->node, handle->id))
+        return 0;
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int lua_openlibtimer(lua_State* L)
+{
+    // New lua state, timers of previous one are gone with their callbacks
+    resetWheel();
+
+    lua_createtable(L, 0, 0);
+    lua_setfield(L, LUA_REGISTRYINDEX, TIMER_CALLBACKS);
+    lua_createtable(L, 0, 0);
+    lua_setfield(L, LUA_REGISTRYINDEX, TIMER_HANDLES);
+
+    luaL_Reg handleMethods[] = {
+        {"Cancel", TimerHandle_Cancel},
+        {"IsCancelled", TimerHandle_IsCancelled},
+    };
+
+    lua_createtable(L, 0, 1); // mt
+    lua_createtable(L, 0, std::size(handleMethods)); // mt, methods
+    for (auto& [name, func] : handleMethods) {
+        lua_pushcfunction(L, func);
+        lua_setfield(L, -2, name);
+    }
+    lua_setfield(L, -2, "__index"); // mt
+    lua_setfield(L, LUA_REGISTRYINDEX, TIMER_HANDLE_MT);
+
+    luaL_Reg methods[] = {
+        {"After", C_Timer_After},
+        {"NewTimer", C_Timer_NewTimer},
+        {"NewTicker", C_Timer_NewTicker},
+    };
+
+    lua_createtable(L, 0, std::size(methods));
+    for (size_t i = 0; i < std::size(methods); i++) {
+        lua_pushcfunction(L, methods[i].func);
+        lua_setfield(L, -2, methods[i].name);
+    }
+    lua_setglobal(L, "C_Timer");
+    return 0;
+}
+
+void Timer::initialize()
+{
+    QueryPerformanceFrequency(&s_frequency);
+    QueryPerformanceCounter(&s_startTime);
+    resetWheel();
+
+    Hooks::FrameXML::registerLuaLib(lua_openlibtimer);
+    Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "TimerWheel.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace TimerWheel;
+
+namespace {
+struct TimerNode {
+    uint32_t id;
+    uint32_t expires;
+    uint32_t interval;
+    int iterations; // < 0 means infinite
+    bool active;
+    uint32_t userData;
+    int prev, next;
+    int* slot; // list head the timer is linked into
+};
+}
+
+static std::vector<TimerNode> s_nodes;
+static std::vector<int> s_freeNodes;
+static int s_root[ROOT_SIZE];
+static int s_levels[LEVELS][LEVEL_SIZE];
+static uint32_t s_currentTick = 0; // next tick to be processed
+static uint32_t s_lastTick = 0; // last advanced tick, timers are scheduled relative to it
+static uint32_t s_nextId = 1;
+
+static int& slotFor(uint32_t expires)
+{
+    uint32_t delta = expires - s_currentTick;
+    if ((int32_t)delta < 0)
+        return s_root[s_currentTick & (ROOT_SIZE - 1)];
+    if (delta < ROOT_SIZE)
+        return s_root[expires & (ROOT_SIZE - 1)];
+    for (uint32_t level = 0; level < LEVELS; level++) {
+        uint32_t shift = ROOT_BITS + LEVEL_BITS * level;
+        if (delta < (1u << (shift + LEVEL_BITS)))
+            return s_levels[level][(expires >> shift) & (LEVEL_SIZE - 1)];
+    }
+    return s_root[0]; // unreachable, delay is clamped
+}
+
+static void link(int idx)
+{
+    TimerNode& node = s_nodes[idx];
+    int& head = slotFor(node.expires);
+    node.slot = &head;
+    node.prev = -1;
+    node.next = head;
+    if (head != -1) s_nodes[head].prev = idx;
+    head = idx;
+}
+
+static void unlink(int idx)
+{
+    TimerNode& node = s_nodes[idx];
+    if (node.prev != -1)
+        s_nodes[node.prev].next = node.next;
+    else if (node.slot && *node.slot == idx)
+        *node.slot = node.next;
+    if (node.next != -1) s_nodes[node.next].prev = node.prev;
+    node.prev = node.next = -1;
+    node.slot = NULL;
+}
+
+static void release(int idx)
+{
+    s_nodes[idx].active = false;
+    s_freeNodes.push_back(idx);
+}
+
+// Moves timers of upper level slot to lower levels, returns slot index
+static uint32_t cascade(uint32_t level)
+{
+    uint32_t slot = (s_currentTick >> (ROOT_BITS + LEVEL_BITS * level)) & (LEVEL_SIZE - 1);
+    int idx = s_levels[level][slot];
+    s_levels[level][slot] = -1;
+    while (idx != -1) {
+        int next = s_nodes[idx].next;
+        link(idx);
+        idx = next;
+    }
+    return slot;
+}
+
+void TimerWheel::reset(uint32_t tick)
+{
+    s_nodes.clear();
+    s_freeNodes.clear();
+    std::fill(std::begin(s_root), std::end(s_root), -1);
+    for (auto& level : s_levels)
+        std::fill(std::begin(level), std::end(level), -1);
+    s_currentTick = tick + 1;
+    s_lastTick = tick;
+}
+
+bool TimerWheel::empty()
+{
+    return s_nodes.size() == s_freeNodes.size();
+}
+
+Due TimerWheel::schedule(uint32_t delay, int iterations, uint32_t userData)
+{
+    int idx;
+    if (!s_freeNodes.empty()) {
+        idx = s_freeNodes.back();
+        s_freeNodes.pop_back();
+    } else {
+        idx = (int)s_nodes.size();
+        s_nodes.emplace_back();
+    }
+
+    delay = std::clamp(delay, 1u, MAX_DELAY);
+    TimerNode& node = s_nodes[idx];
+    node.id = s_nextId++;
+    node.expires = s_lastTick + delay;
+    node.interval = delay;
+    node.iterations = iterations;
+    node.active = true;
+    node.userData = userData;
+    node.slot = NULL;
+    link(idx);
+    return { idx, node.id };
+}
+
+bool TimerWheel::isActive(int node, uint32_t id)
+{
+    return node >= 0 && (size_t)node < s_nodes.size() && s_nodes[node].id == id && s_nodes[node].active;
+}
+
+uint32_t TimerWheel::getUserData(int node)
+{
+    return s_nodes[node].userData;
+}
+
+void TimerWheel::cancel(int node)
+{
+    unlink(node);
+    release(node);
+}
+
+void TimerWheel::advance(uint32_t tick, std::vector<Due>& out)
+{
+    if (empty()) {
+        s_currentTick = tick + 1;
+        s_lastTick = tick;
+        return;
+    }
+
+    while ((int32_t)(tick - s_currentTick) >= 0) {
+        uint32_t slot = s_currentTick & (ROOT_SIZE - 1);
+        if (slot == 0)
+            for (uint32_t level = 0; level < LEVELS && cascade(level) == 0; level++);
+
+        int idx = s_root[slot];
+        s_root[slot] = -1;
+        while (idx != -1) {
+            TimerNode& node = s_nodes[idx];
+            int next = node.next;
+            node.prev = node.next = -1;
+            node.slot = NULL;
+            out.push_back({ idx, node.id });
+            idx = next;
+        }
+        s_currentTick++;
+    }
+    s_lastTick = s_currentTick - 1;
+}
+
+bool TimerWheel::rearm(int idx)
+{
+    TimerNode& node = s_nodes[idx];
+    if (node.iterations >= 0 && --node.iterations <= 0) {
+        release(idx);
+        return false;
+    }
+    node.expires = s_lastTick + node.interval;
+    link(idx);
+    return true;
+}
\ No newline at end of file
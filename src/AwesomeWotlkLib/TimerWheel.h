@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/*
+    Hierarchical timer wheel: root wheel holds timers due within 256 ticks, every next level covers
+    64 times longer span and gets cascaded into lower one when its slot comes. Insertion, cancel and
+    per-tick work are O(1), only due timers are touched. Knows nothing about Lua, so it's also built
+    on host by tools/TimerWheelBench.
+*/
+namespace TimerWheel {
+constexpr uint32_t TICK_MS = 10;
+constexpr uint32_t ROOT_BITS = 8;
+constexpr uint32_t ROOT_SIZE = 1 << ROOT_BITS;
+constexpr uint32_t LEVEL_BITS = 6;
+constexpr uint32_t LEVEL_SIZE = 1 << LEVEL_BITS;
+constexpr uint32_t LEVELS = 3;
+constexpr uint32_t MAX_DELAY = (1 << (ROOT_BITS + LEVEL_BITS * LEVELS)) - 1; // ~7.7 days
+
+// Timer is addressed by node and id, node is reused after timer is released
+struct Due {
+    int node;
+    uint32_t id;
+};
+
+// Drops all timers, delays of new ones are counted from tick
+void reset(uint32_t tick);
+bool empty();
+
+// Delay is in ticks and clamped to [1, MAX_DELAY], iterations < 0 means infinite. userData is kept as is
+Due schedule(uint32_t delay, int iterations, uint32_t userData);
+bool isActive(int node, uint32_t id);
+uint32_t getUserData(int node);
+void cancel(int node);
+
+// Appends timers due up to tick to out. Due timers are detached, pass each of them to rearm after firing
+void advance(uint32_t tick, std::vector<Due>& out);
+// Links repeating timer again relative to last advanced tick, releases it and returns false if it's finished
+bool rearm(int node);
+}
\ No newline at end of file
@@ -1,12 +1,56 @@
 #include "UnitAPI.h"
 #include "GameClient.h"
 #include "Hooks.h"
+#include "Objects.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
 
+#define UNIT_CONTROL_CHANGED "UNIT_CONTROL_CHANGED"
+#define UNIT_SILENCE_CHANGED "UNIT_SILENCE_CHANGED"
+#define UNIT_DISARM_CHANGED "UNIT_DISARM_CHANGED"
+
+static constexpr uint32_t UNIT_FLAGS_CONTROL = UNIT_FLAG_FLEEING | UNIT_FLAG_CONFUSED | UNIT_FLAG_STUNNED | UNIT_FLAG_PACIFIED;
+
+struct FlagTransition {
+    const char* event;
+    uint32_t mask;
+    int eventId;
+};
+
+static FlagTransition s_transitions[] = {
+    { UNIT_CONTROL_CHANGED, UNIT_FLAGS_CONTROL, -1 },
+    { UNIT_SILENCE_CHANGED, UNIT_FLAG_SILENCED, -1 },
+    { UNIT_DISARM_CHANGED, UNIT_FLAG_DISARMED, -1 },
+};
+
+struct TrackedFlags {
+    uint32_t flags;
+    uint32_t frame;
+};
+
+// Flags of every visible unit as of previous frame
+static std::unordered_map<guid_t, TrackedFlags> s_trackedFlags;
+
+// Flags as of this frame's snapshot, 0 if unit isn't visible
+static void getSlotFlags(int slot, uint32_t& flags, uint32_t& flags2)
+{
+    flags = slot >= 0 ? Objects::get().flags[slot] : 0;
+    flags2 = slot >= 0 ? Objects::get().flags2[slot] : 0;
+}
+
+static uint32_t lua_checkunitflags(lua_State* L, int idx)
+{
+    uint32_t flags, flags2;
+    getSlotFlags(Objects::checkSlot(L, idx), flags, flags2);
+    return flags;
+}
 
 static int lua_UnitIsControlled(lua_State* L)
 {
-    Unit* unit = (Unit*)ObjectMgr::Get(luaL_checkstring(L, 1), ObjectFlags_Unit);
-    if (!unit || !(unit->entry->flags & (UNIT_FLAG_FLEEING | UNIT_FLAG_CONFUSED | UNIT_FLAG_STUNNED | UNIT_FLAG_PACIFIED)))
+    if (!(lua_checkunitflags(L, 1) & UNIT_FLAGS_CONTROL))
         return 0;
     lua_pushnumber(L, 1);
     return 1;
@@ -14,8 +58,7 @@ static int lua_UnitIsControlled(lua_State* L)
 
 static int lua_UnitIsDisarmed(lua_State* L)
 {
-    Unit* unit = (Unit*)ObjectMgr::Get(luaL_checkstring(L, 1), ObjectFlags_Unit);
-    if (!unit || !(unit->entry->flags & UNIT_FLAG_DISARMED))
+    if (!(lua_checkunitflags(L, 1) & UNIT_FLAG_DISARMED))
         return 0;
     lua_pushnumber(L, 1);
     return 1;
@@ -23,15 +66,274 @@ static int lua_UnitIsDisarmed(lua_State* L)
 
 static int lua_UnitIsSilenced(lua_State* L)
 {
-    Unit* unit = (Unit*)ObjectMgr::Get(luaL_checkstring(L, 1), ObjectFlags_Unit);
-    if (!unit || !(unit->entry->flags & UNIT_FLAG_SILENCED))
+    if (!(lua_checkunitflags(L, 1) & UNIT_FLAG_SILENCED))
         return 0;
     lua_pushnumber(L, 1);
     return 1;
 }
 
+static int C_Unit_GetStateFlags(lua_State* L)
+{
+    uint32_t flags, flags2;
+    getSlotFlags(Objects::checkSlot(L, 1), flags, flags2);
+    lua_pushnumber(L, flags);
+    lua_pushnumber(L, flags2);
+    return 2;
+}
+
+static int C_Unit_GetStateFlagsBatch(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int count = lua_objlen(L, 1);
+    lua_pushresulttable(L, 2, count * 2, 0); // tbl
+    for (int i = 1; i <= count; i++) {
+        lua_rawgeti(L, 1, i); // tbl, unit
+        uint32_t flags, flags2;
+        getSlotFlags(Objects::toSlot(L, -1), flags, flags2);
+        lua_pop(L, 1); // tbl
+        lua_pushnumber(L, flags);
+        lua_rawseti(L, -2, i * 2 - 1);
+        lua_pushnumber(L, flags2);
+        lua_rawseti(L, -2, i * 2);
+    }
+    lua_wipetail(L, -1, count * 2 + 1);
+    return 1;
+}
+
+static int C_Unit_GetHandle(lua_State* L)
+{
+    guid_t guid = Objects::checkGuid(L, 1);
+    if (!guid) return 0;
+    Objects::pushHandle(L, guid);
+    return 1;
+}
+
+static int C_Unit_ReleaseHandle(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TUSERDATA);
+    if (!Objects::releaseHandle(L, 1)) return 0;
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int C_Unit_GetGuid(lua_State* L)
+{
+    guid_t guid = Objects::checkGuid(L, 1);
+    if (!guid) return 0;
+    lua_pushguid(L, guid);
+    return 1;
+}
+
+static int C_Unit_GetPosition(lua_State* L)
+{
+    int slot = Objects::checkSlot(L, 1);
+    if (slot < 0) return 0;
+    const VecXYZ& pos = Objects::get().positions[slot];
+    lua_pushnumber(L, pos.x);
+    lua_pushnumber(L, pos.y);
+    lua_pushnumber(L, pos.z);
+    return 3;
+}
+
+static void lua_queryradius(lua_State* L, std::vector<int>& slots)
+{
+    float x = luaL_checknumber(L, 1);
+    float y = luaL_checknumber(L, 2);
+    float radius = luaL_checknumber(L, 3);
+    uint32_t requiredFlags = lua_isnoneornil(L, 4) ? 0 : (uint32_t)luaL_checknumber(L, 4);
+    Objects::queryRadius(x, y, radius, requiredFlags, slots);
+}
+
+static int C_Unit_GetUnitsInRadius(lua_State* L)
+{
+    static std::vector<int> s_slots;
+    s_slots.clear();
+    lua_queryradius(L, s_slots);
+
+    const Objects::Snapshot& objects = Objects::get();
+    lua_pushresulttable(L, 5, s_slots.size(), 0); // tbl
+    int id = 1;
+    for (int slot : s_slots) {
+        lua_pushguid(L, objects.guids[slot]);
+        lua_rawseti(L, -2, id++);
+    }
+    lua_wipetail(L, -1, id);
+    return 1;
+}
+
+static int C_Unit_CountUnitsInRadius(lua_State* L)
+{
+    static std::vector<int> s_slots;
+    s_slots.clear();
+    lua_queryradius(L, s_slots);
+    lua_pushnumber(L, s_slots.size());
+    return 1;
+}
+
+/*
+    Group ranges: positions of raid (or party) members and their pets are gathered into coordinate arrays,
+    then distances to player are computed in one branchless pass. Done at most once per frame.
+    Guids of roster are resolved from tokens only after group or pets change
+*/
+static constexpr int MAX_GROUP_MEMBERS = 40;
+static constexpr int GROUP_RANGE_SLOTS = MAX_GROUP_MEMBERS * 2; // member i at i, its pet at 40 + i
+
+struct GroupRanges {
+    uint32_t frame;
+    float x[GROUP_RANGE_SLOTS], y[GROUP_RANGE_SLOTS], z[GROUP_RANGE_SLOTS];
+    float distanceSq[GROUP_RANGE_SLOTS];
+    bool visible[GROUP_RANGE_SLOTS];
+};
+
+static GroupRanges s_groupRanges;
+static char s_raidTokens[GROUP_RANGE_SLOTS][16];
+static char s_partyTokens[GROUP_RANGE_SLOTS][16];
+static guid_t s_rosterGuids[GROUP_RANGE_SLOTS];
+static bool s_rosterDirty = true;
+static std::vector<bool> s_rosterEvents; // by eventId
+
+static const char* s_rosterEventNames[] = {
+    "RAID_ROSTER_UPDATE", "PARTY_MEMBERS_CHANGED", "UNIT_PET", "PLAYER_ENTERING_WORLD",
+};
+
+static void initGroupTokens()
+{
+    for (int i = 0; i < MAX_GROUP_MEMBERS; i++) {
+        snprintf(s_raidTokens[i], std::size(s_raidTokens[i]), "raid%d", i + 1);
+        snprintf(s_raidTokens[MAX_GROUP_MEMBERS + i], std::size(s_raidTokens[i]), "raidpet%d", i + 1);
+        if (i < 4) {
+            snprintf(s_partyTokens[i], std::size(s_partyTokens[i]), "party%d", i + 1);
+            snprintf(s_partyTokens[MAX_GROUP_MEMBERS + i], std::size(s_partyTokens[i]), "partypet%d", i + 1);
+        }
+    }
+}
+
+static void updateRoster()
+{
+    s_rosterDirty = false;
+    auto& tokens = ObjectMgr::String2Guid("raid1") ? s_raidTokens : s_partyTokens;
+    for (int i = 0; i < GROUP_RANGE_SLOTS; i++)
+        s_rosterGuids[i] = tokens[i][0] ? ObjectMgr::String2Guid(tokens[i]) : 0;
+}
+
+static bool rosterFilter(int eventId, lua_State*, int)
+{
+    if (eventId >= 0 && (size_t)eventId < s_rosterEvents.size() && s_rosterEvents[eventId])
+        s_rosterDirty = true;
+    return true;
+}
+
+static void updateGroupRanges()
+{
+    const Objects::Snapshot& objects = Objects::get();
+    GroupRanges& ranges = s_groupRanges;
+    if (ranges.frame == objects.frame) return;
+    ranges.frame = objects.frame;
+
+    if (objects.player < 0) {
+        std::fill(std::begin(ranges.visible), std::end(ranges.visible), false);
+        return;
+    }
+
+    if (s_rosterDirty) updateRoster();
+    const VecXYZ& origin = objects.positions[objects.player];
+    for (int i = 0; i < GROUP_RANGE_SLOTS; i++) {
+        int slot = Objects::find(s_rosterGuids[i]);
+        const VecXYZ& pos = slot >= 0 ? objects.positions[slot] : origin;
+        ranges.visible[i] = slot >= 0;
+        ranges.x[i] = pos.x;
+        ranges.y[i] = pos.y;
+        ranges.z[i] = pos.z;
+    }
+
+    // Plain loop over contiguous floats, vectorized by compiler
+    for (int i = 0; i < GROUP_RANGE_SLOTS; i++) {
+        float dx = ranges.x[i] - origin.x, dy = ranges.y[i] - origin.y, dz = ranges.z[i] - origin.z;
+        ranges.distanceSq[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+static int C_Unit_GetGroupRanges(lua_State* L)
+{
+    updateGroupRanges();
+    lua_pushresulttable(L, 1, GROUP_RANGE_SLOTS, 0); // tbl
+    for (int i = 0; i < GROUP_RANGE_SLOTS; i++) {
+        lua_pushnumber(L, s_groupRanges.visible[i] ? std::sqrt(s_groupRanges.distanceSq[i]) : -1.0);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+static void fireTransitions(guid_t guid, uint32_t changed)
+{
+    // Events are fired for every token of the unit, tokens are copied since handlers reuse the buffer
+    char tokens[8][32];
+    size_t count = 0;
+    char** keywords = ObjectMgr::GetKeywordsByGuid(&guid, &count);
+    if (!keywords) return;
+    count = (std::min)(count, std::size(tokens));
+    for (size_t i = 0; i < count; i++)
+        snprintf(tokens[i], std::size(tokens[i]), "%s", keywords[i]);
+
+    lua_State* L = GetLuaState();
+    for (FlagTransition& transition : s_transitions) {
+        if (!(changed & transition.mask)) continue;
+        if (transition.eventId < 0) transition.eventId = FrameScript::GetEventIdByName(transition.event);
+        if (transition.eventId < 0) continue;
+        for (size_t i = 0; i < count; i++) {
+            lua_pushstring(L, transition.event); // event
+            lua_pushstring(L, tokens[i]); // event, unit
+            lua_pushnumber(L, changed & transition.mask); // event, unit, changed
+            FrameScript::FireEvent_inner(transition.eventId, L, 3);
+            lua_pop(L, 3);
+        }
+    }
+}
+
+static void onUpdateCallback()
+{
+    const Objects::Snapshot& objects = Objects::get();
+    if (!objects.size()) {
+        s_trackedFlags.clear();
+        return;
+    }
+
+    static std::vector<std::pair<guid_t, uint32_t>> s_changed;
+    for (size_t slot = 0; slot < objects.size(); slot++) {
+        auto [it, inserted] = s_trackedFlags.try_emplace(objects.guids[slot], TrackedFlags{ objects.flags[slot], objects.frame });
+        uint32_t changed = it->second.flags ^ objects.flags[slot];
+        it->second = { objects.flags[slot], objects.frame };
+        if (!inserted && (changed & (UNIT_FLAGS_CONTROL | UNIT_FLAG_SILENCED | UNIT_FLAG_DISARMED)))
+            s_changed.push_back({ objects.guids[slot], changed });
+    }
+
+    // Units out of sight for a while start from scratch when seen again
+    if ((objects.frame & 63) == 0) {
+        for (auto it = s_trackedFlags.begin(); it != s_trackedFlags.end();)
+            it = it->second.frame != objects.frame ? s_trackedFlags.erase(it) : std::next(it);
+    }
+
+    for (auto& [guid, changed] : s_changed)
+        fireTransitions(guid, changed);
+    s_changed.clear();
+}
+
 static int lua_openunitlib(lua_State* L)
 {
+    // Event ids are resolved on first transition
+    for (FlagTransition& transition : s_transitions)
+        transition.eventId = -1;
+    s_trackedFlags.clear();
+
+    s_rosterEvents.clear();
+    for (const char* name : s_rosterEventNames) {
+        int eventId = FrameScript::GetEventIdByName(name);
+        if (eventId < 0) continue;
+        if ((size_t)eventId >= s_rosterEvents.size()) s_rosterEvents.resize(eventId + 1);
+        s_rosterEvents[eventId] = true;
+    }
+    s_rosterDirty = true;
+
     luaL_Reg funcs[] = {
         { "UnitIsControlled", lua_UnitIsControlled },
         { "UnitIsDisarmed", lua_UnitIsDisarmed },
@@ -43,10 +345,35 @@ static int lua_openunitlib(lua_State* L)
         lua_setglobal(L, name);
     }
 
+    luaL_Reg methods[] = {
+        {"GetHandle", C_Unit_GetHandle},
+        {"ReleaseHandle", C_Unit_ReleaseHandle},
+        {"GetGuid", C_Unit_GetGuid},
+        {"GetStateFlags", C_Unit_GetStateFlags},
+        {"GetStateFlagsBatch", C_Unit_GetStateFlagsBatch},
+        {"GetPosition", C_Unit_GetPosition},
+        {"GetUnitsInRadius", C_Unit_GetUnitsInRadius},
+        {"CountUnitsInRadius", C_Unit_CountUnitsInRadius},
+        {"GetGroupRanges", C_Unit_GetGroupRanges},
+    };
+
+    lua_createtable(L, 0, std::size(methods));
+    for (size_t i = 0; i < std::size(methods); i++) {
+        lua_pushcfunction(L, methods[i].func);
+        lua_setfield(L, -2, methods[i].name);
+    }
+    lua_setglobal(L, "C_Unit");
     return 0;
 }
 
 void UnitAPI::initialize()
 {
+    initGroupTokens();
+
     Hooks::FrameXML::registerLuaLib(lua_openunitlib);
+    Hooks::FrameXML::registerEvent(UNIT_CONTROL_CHANGED);
+    Hooks::FrameXML::registerEvent(UNIT_SILENCE_CHANGED);
+    Hooks::FrameXML::registerEvent(UNIT_DISARM_CHANGED);
+    Hooks::FrameScript::registerOnUpdate(onUpdateCallback);
+    Hooks::FrameScript::registerEventFilter(rosterFilter);
 }
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "UnitEvents.h"
+#include "GameClient.h"
+#include "Hooks.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct UnitEventListener {
+    Frame* frame;
+    char units[2][32];
+
+    bool match(const char* unit) const
+    {
+        for (const char* u : units)
+            if (u[0] && strcmp(u, unit) == 0)
+                return true;
+        return false;
+    }
+};
+
+// eventId -> frames registered through RegisterUnitEvent
+static std::unordered_map<int, std::vector<UnitEventListener>> s_unitEvents;
+
+/*
+    Coalescing: events listed in eventCoalescing cvar which carry only unit argument are held back,
+    repeated (event, unit) pairs are dropped and each pair is fired once at start of next OnUpdate,
+    so handlers see final state of the unit instead of every intermediate one.
+*/
+struct PendingEvent {
+    int eventId;
+    std::string unit;
+};
+
+struct CoalescingStats {
+    uint32_t delivered;
+    uint32_t dropped;
+};
+
+static Console::CVar* s_cvar_eventCoalescing;
+static std::vector<bool> s_coalescible; // by eventId
+static std::vector<PendingEvent> s_pendingEvents;
+static std::unordered_set<std::string> s_pendingKeys;
+static std::unordered_map<int, CoalescingStats> s_coalescingStats;
+static bool s_deliveringPending = false;
+
+
+static void onFireEvent(int eventId, lua_State* L, int nargs)
+{
+    if (s_unitEvents.empty() || nargs < 2) return;
+    auto it = s_unitEvents.find(eventId);
+    if (it == s_unitEvents.end()) return;
+
+    const char* unit = lua_tolstring(L, -nargs + 1, NULL);
+    if (!unit) return;
+
+    // Handlers may (un)register during dispatch, so collect first
+    static std::vector<Frame*> s_dispatch;
+    size_t begin = s_dispatch.size();
+    for (const UnitEventListener& listener : it->second)
+        if (listener.match(unit))
+            s_dispatch.push_back(listener.frame);
+
+    for (size_t i = begin; i < s_dispatch.size(); i++)
+        lua_callframescript(L, s_dispatch[i], "OnEvent", nargs);
+    s_dispatch.resize(begin);
+}
+
+static void resolveCoalescible(const char* list)
+{
+    s_coalescible.clear();
+    std::string names = list ? list : "";
+    for (size_t pos = 0; pos < names.size();) {
+        size_t end = names.find_first_of(", ", pos);
+        if (end == std::string::npos) end = names.size();
+        if (end > pos) {
+            int eventId = FrameScript::GetEventIdByName(names.substr(pos, end - pos).c_str());
+            if (eventId >= 0) {
+                if ((size_t)eventId >= s_coalescible.size()) s_coalescible.resize(eventId + 1);
+                s_coalescible[eventId] = true;
+            }
+        }
+        pos = end + 1;
+    }
+}
+
+static int CVarHandler_eventCoalescing(Console::CVar*, const char*, const char* value, void*)
+{
+    // Events aren't known before FrameXML is loaded, list is resolved again then
+    if (GetLuaState()) resolveCoalescible(value);
+    return 1;
+}
+
+static bool coalescingFilter(int eventId, lua_State* L, int nargs)
+{
+    if (s_deliveringPending || nargs != 2 || eventId < 0 || (size_t)eventId >= s_coalescible.size() || !s_coalescible[eventId])
+        return true;
+    if (lua_type(L, -1) != LUA_TSTRING) return true;
+
+    const char* unit = lua_tostring(L, -1);
+    char key[48];
+    snprintf(key, std::size(key), "%d:%s", eventId, unit);
+    if (s_pendingKeys.insert(key).second)
+        s_pendingEvents.push_back({ eventId, unit });
+    else
+        s_coalescingStats[eventId].dropped++;
+    return false;
+}
+
+static void deliverPendingEvents()
+{
+    if (s_pendingEvents.empty()) return;
+
+    // Handlers may fire new events, they are held until next frame
+    static std::vector<PendingEvent> s_delivering;
+    s_delivering.swap(s_pendingEvents);
+    s_pendingKeys.clear();
+
+    lua_State* L = GetLuaState();
+    s_deliveringPending = true;
+    for (PendingEvent& event : s_delivering) {
+        const char* name = FrameScript::GetEventNameById(event.eventId);
+        if (!name) continue;
+        lua_pushstring(L, name); // event
+        lua_pushstring(L, event.unit.c_str()); // event, unit
+        FrameScript::FireEvent_inner(event.eventId, L, 2);
+        lua_pop(L, 2);
+        s_coalescingStats[event.eventId].delivered++;
+    }
+    s_deliveringPending = false;
+    s_delivering.clear();
+}
+
+static int lua_GetEventCoalescingStats(lua_State* L)
+{
+    lua_pushresulttable(L, 1, 0, s_coalescingStats.size()); // tbl
+    for (auto& [eventId, stats] : s_coalescingStats) {
+        const char* name = FrameScript::GetEventNameById(eventId);
+        if (!name) continue;
+        lua_getfield(L, -1, name); // tbl, entry
+        if (!lua_istable(L, -1)) {
+            lua_pop(L, 1); // tbl
+            lua_createtable(L, 0, 2); // tbl, entry
+            lua_pushvalue(L, -1); // tbl, entry, entry
+            lua_setfield(L, -3, name); // tbl, entry
+        }
+        lua_pushnumber(L, stats.delivered);
+        lua_setfield(L, -2, "delivered");
+        lua_pushnumber(L, stats.dropped);
+        lua_setfield(L, -2, "dropped");
+        lua_pop(L, 1); // tbl
+    }
+    return 1;
+}
+
+static int lua_openlibunitevents(lua_State* L)
+{
+    // Frames of previous state are gone with it
+    s_unitEvents.clear();
+    s_pendingEvents.clear();
+    s_pendingKeys.clear();
+    s_coalescingStats.clear();
+    resolveCoalescible(s_cvar_eventCoalescing ? s_cvar_eventCoalescing->vStr : NULL);
+
+    lua_pushcfunction(L, lua_GetEventCoalescingStats);
+    lua_setglobal(L, "GetEventCoalescingStats");
+    return 0;
+}
+
+static void copyUnitToken(char* dst, size_t size, const char* src)
+{
+    size_t i = 0;
+    for (; src && src[i] && i + 1 < size; i++)
+        dst[i] = tolower((unsigned char)src[i]);
+    dst[i] = '\0';
+}
+
+static bool removeListener(int eventId, Frame* frame)
+{
+    auto it = s_unitEvents.find(eventId);
+    if (it == s_unitEvents.end()) return false;
+    auto& listeners = it->second;
+    auto removed = std::remove_if(listeners.begin(), listeners.end(), [frame](const UnitEventListener& listener) {
+        return listener.frame == frame;
+    });
+    if (removed == listeners.end()) return false;
+    listeners.erase(removed, listeners.end());
+    if (listeners.empty()) s_unitEvents.erase(it);
+    return true;
+}
+
+static int lua_RegisterUnitEvent(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    const char* event = luaL_checkstring(L, 2);
+    const char* unit1 = luaL_checkstring(L, 3);
+    const char* unit2 = lua_type(L, 4) == LUA_TSTRING ? lua_tostring(L, 4) : NULL;
+
+    Frame* frame = lua_toframe_silent(L, 1);
+    int eventId = FrameScript::GetEventIdByName(event);
+    if (!frame || eventId < 0) return 0;
+
+    // Unfiltered registration would deliver the event twice
+    lua_getfield(L, 1, "UnregisterEvent"); // func
+    lua_pushvalue(L, 1); // func, frame
+    lua_pushvalue(L, 2); // func, frame, event
+    if (lua_pcall(L, 2, 0, 0)) lua_pop(L, 1);
+
+    removeListener(eventId, frame);
+    UnitEventListener& listener = s_unitEvents[eventId].emplace_back();
+    listener.frame = frame;
+    copyUnitToken(listener.units[0], std::size(listener.units[0]), unit1);
+    copyUnitToken(listener.units[1], std::size(listener.units[1]), unit2);
+
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+static int lua_UnregisterUnitEvent(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    const char* event = luaL_checkstring(L, 2);
+
+    Frame* frame = lua_toframe_silent(L, 1);
+    int eventId = FrameScript::GetEventIdByName(event);
+    if (!frame || eventId < 0 || !removeListener(eventId, frame)) return 0;
+
+    lua_pushnumber(L, 1);
+    return 1;
+}
+
+void UnitEvents::initialize()
+{
+    Hooks::FrameXML::registerFrameMethod("RegisterUnitEvent", lua_RegisterUnitEvent);
+    Hooks::FrameXML::registerFrameMethod("UnregisterUnitEvent", lua_UnregisterUnitEvent);
+    Hooks::FrameScript::registerOnFireEvent(onFireEvent);
+    Hooks::FrameScript::registerEventFilter(coalescingFilter);
+    Hooks::FrameScript::registerOnUpdate(deliverPendingEvents);
+    Hooks::FrameXML::registerLuaLib(lua_openlibunitevents);
+    Hooks::FrameXML::registerCVar(&s_cvar_eventCoalescing, "eventCoalescing", NULL, (Console::CVarFlags)1, "", CVarHandler_eventCoalescing);
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#pragma once
+
+namespace UnitEvents {
+void initialize();
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+    Uniform grid over XY bounds of unit positions. Slots are counting-sorted by cell, so units of cell i are
+    cellSlots[cellStart[i] .. cellStart[i + 1]). Position only needs x and y members, so grid is also built
+    on host by tools/UnitGridBench.
+*/
+struct UnitGrid {
+    static constexpr float CELL_SIZE = 10.f;
+    static constexpr int MAX_CELLS = 4096;
+
+    float minX, minY;
+    float cellSize;
+    int cols = 0, rows = 0;
+    std::vector<int> cellStart;
+    std::vector<int> cellSlots;
+    std::vector<int> slotCells;
+    std::vector<int> fill; // scratch of build
+
+    template <typename Pos>
+    void build(const std::vector<Pos>& positions);
+
+    // Slots within radius of point on XY plane whose flags have all of requiredFlags set, appended to out
+    template <typename Pos>
+    void query(const std::vector<Pos>& positions, const std::vector<uint32_t>& flags, float x, float y, float radius,
+        uint32_t requiredFlags, std::vector<int>& out) const;
+
+private:
+    // Cell column/row of coordinate clamped to grid, done in float so huge values don't overflow int conversion
+    static int toCell(float value, float min, float cellSize, int count)
+    {
+        float cell = std::floor((value - min) / cellSize);
+        return (int)(std::max)(0.f, (std::min)(cell, (float)(count - 1)));
+    }
+};
+
+template <typename Pos>
+void UnitGrid::build(const std::vector<Pos>& positions)
+{
+    if (positions.empty()) {
+        cols = rows = 0;
+        return;
+    }
+
+    float maxX, maxY;
+    minX = maxX = positions[0].x;
+    minY = maxY = positions[0].y;
+    for (const Pos& pos : positions) {
+        minX = (std::min)(minX, pos.x);
+        maxX = (std::max)(maxX, pos.x);
+        minY = (std::min)(minY, pos.y);
+        maxY = (std::max)(maxY, pos.y);
+    }
+
+    // Far spread units get bigger cells, so the grid stays small
+    cellSize = CELL_SIZE;
+    while (((maxX - minX) / cellSize + 1) * ((maxY - minY) / cellSize + 1) > MAX_CELLS)
+        cellSize *= 2;
+    cols = (int)((maxX - minX) / cellSize) + 1;
+    rows = (int)((maxY - minY) / cellSize) + 1;
+
+    cellStart.assign(cols * rows + 1, 0);
+    slotCells.resize(positions.size());
+    for (size_t slot = 0; slot < positions.size(); slot++) {
+        int cx = (int)((positions[slot].x - minX) / cellSize);
+        int cy = (int)((positions[slot].y - minY) / cellSize);
+        int cell = cy * cols + cx;
+        slotCells[slot] = cell;
+        cellStart[cell + 1]++;
+    }
+    for (size_t i = 1; i < cellStart.size(); i++)
+        cellStart[i] += cellStart[i - 1];
+
+    cellSlots.resize(positions.size());
+    fill.assign(cellStart.begin(), cellStart.end() - 1);
+    for (size_t slot = 0; slot < positions.size(); slot++)
+        cellSlots[fill[slotCells[slot]]++] = (int)slot;
+}
+
+template <typename Pos>
+void UnitGrid::query(const std::vector<Pos>& positions, const std::vector<uint32_t>& flags, float x, float y, float radius,
+    uint32_t requiredFlags, std::vector<int>& out) const
+{
+    // Negated comparison also rejects NaN
+    if (!cols || !(radius >= 0.f) || std::isnan(x) || std::isnan(y)) return;
+
+    int x0 = toCell(x - radius, minX, cellSize, cols);
+    int x1 = toCell(x + radius, minX, cellSize, cols);
+    int y0 = toCell(y - radius, minY, cellSize, rows);
+    int y1 = toCell(y + radius, minY, cellSize, rows);
+
+    float radiusSq = radius * radius;
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            int cell = cy * cols + cx;
+            for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+                int slot = cellSlots[i];
+                const Pos& pos = positions[slot];
+                float dx = pos.x - x, dy = pos.y - y;
+                if (dx * dx + dy * dy <= radiusSq && (flags[slot] & requiredFlags) == requiredFlags)
+                    out.push_back(slot);
+            }
+        }
+    }
+}
\ No newline at end of file
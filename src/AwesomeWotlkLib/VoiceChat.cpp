@@ -3,8 +3,9 @@
 //
 // Provides two Lua globals:
 //   1) C_VoiceChat
-//        - GetTtsVoices()                -> { {voiceID=..., name="..."}, ... }
-//        - GetRemoteTtsVoices()          -> same as GetTtsVoices()
+//        - GetTtsVoices([tbl])           -> { {voiceID=..., name="..."}, ... }
+//        - GetRemoteTtsVoices([tbl])     -> same as GetTtsVoices()
+//            tbl (table): optional table to fill in place instead of allocating a new one
 //        - SpeakText(voiceID, text[, destination, rate, volume])
 //            destination (number):
 //              1 -> speak immediately (no special handling; SAPI queues FIFO)
@@ -39,7 +40,9 @@
 // * Uses CVars: ttsVoice, ttsSpeed, ttsVolume (with clamping callbacks).
 // * SAPI speech is async; stream numbers are mapped to utterance metadata.
 // * durationMS in START event is always 0 (Blizzard-like behavior).
-// * A single global ISpVoice instance is used.
+// * A single global ISpVoice instance is used, created lazily on first speak.
+// * Voice list is enumerated once by warmUp() on a background thread and cached;
+//   GetTtsVoices/RefreshVoices re-enumerate on demand.
 // ============================================================================
 
 #include "VoiceChat.h"
@@ -55,6 +58,7 @@
 #include <limits>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <unordered_map>
 #include <algorithm>
 
@@ -72,6 +76,7 @@
 // ============================================================================
 struct VoiceTtsVoiceType;
 static std::vector<VoiceTtsVoiceType> VoiceChat_GetTtsVoices();
+static std::vector<VoiceTtsVoiceType> VoiceChat_GetCachedVoices(bool wait = true);
 static void VoiceChat_InitVoice();
 
 // ============================================================================
@@ -114,7 +119,11 @@ static int GetNextUtteranceID() {
     return v;
 }
 
+// Guarded by g_voicesMx, filled by warm-up thread or RefreshVoices
 static std::vector<VoiceTtsVoiceType> g_cachedVoices;
+static std::mutex g_voicesMx;
+static std::condition_variable g_voicesCv;
+static bool g_voicesReady = false;
 
 static Console::CVar* s_cvar_voiceID;
 static Console::CVar* s_cvar_speed;
@@ -166,7 +175,7 @@ struct VoiceTtsVoiceType {
 // Resolve a voice name by its index (returns UTF-8)
 static std::string GetVoiceNameByID(int voiceID)
 {
-    auto voices = VoiceChat_GetTtsVoices();
+    auto voices = VoiceChat_GetCachedVoices();
     if (voiceID < 0 || voiceID >= (int)voices.size()) return std::string();
     return WideStringToUtf8(voices[voiceID].name);
 }
@@ -360,10 +369,9 @@ void VoiceChat_InitVoice()
 // ============================================================================
 // SAPI Voice Utilities (enumeration / stop-all / speak)
 // ============================================================================
-static std::vector<VoiceTtsVoiceType> VoiceChat_GetTtsVoices()
+// Caller is responsible for COM being initialized on its thread
+static std::vector<VoiceTtsVoiceType> VoiceChat_EnumTtsVoices()
 {
-    VoiceChat_InitCOM();
-
     std::vector<VoiceTtsVoiceType> voices;
     IEnumSpObjectTokens* pEnum = nullptr;
     ULONG count = 0;
@@ -390,6 +398,21 @@ static std::vector<VoiceTtsVoiceType> VoiceChat_GetTtsVoices()
     return voices;
 }
 
+static std::vector<VoiceTtsVoiceType> VoiceChat_GetTtsVoices()
+{
+    VoiceChat_InitCOM();
+    return VoiceChat_EnumTtsVoices();
+}
+
+// Voices enumerated by warm-up or last refresh. Without wait returns empty list if warm-up isn't done yet
+static std::vector<VoiceTtsVoiceType> VoiceChat_GetCachedVoices(bool wait)
+{
+    std::unique_lock<std::mutex> lock(g_voicesMx);
+    if (wait)
+        g_voicesCv.wait(lock, [] { return g_voicesReady; });
+    return g_cachedVoices;
+}
+
 static std::vector<VoiceTtsVoiceType> VoiceChat_GetRemoteTtsVoices()
 {
     // Placeholder: currently identical to local TTS voices.
@@ -400,6 +423,8 @@ static void VoiceChat_RefreshVoices()
 {
     auto newVoices = VoiceChat_GetTtsVoices();
 
+    std::unique_lock<std::mutex> lock(g_voicesMx);
+
     // Compare with cache
     bool changed = false;
     if (newVoices.size() != g_cachedVoices.size()) {
@@ -414,6 +439,9 @@ static void VoiceChat_RefreshVoices()
     }
 
     g_cachedVoices = std::move(newVoices);
+    g_voicesReady = true;
+    lock.unlock();
+    g_voicesCv.notify_all();
 
     if (changed) {
         FireEvent_NoArgs(VOICE_CHAT_TTS_VOICES_UPDATE);
@@ -422,7 +450,7 @@ static void VoiceChat_RefreshVoices()
 
 static void VoiceChat_StopAll()
 {
-    VoiceChat_InitVoice();
+    // Nothing could be spoken before voice was created
     if (!g_pVoice) return;
 
     // Stop and purge all queued/ongoing speech in SAPI
@@ -473,18 +501,16 @@ void VoiceChat_SpeakText(const std::wstring& text)
 // ============================================================================
 // Lua Bindings – C_VoiceChat (enumeration / speak / stop-all)
 // ============================================================================
-static int Lua_VoiceChat_GetTtsVoices(lua_State* L)
+// Fills table at idx (or a new presized one) with { {voiceID=..., name="..."}, ... },
+// entry tables of a reused table are reused as well
+static void PushTtsVoicesTable(lua_State* L, int idx, const std::vector<VoiceTtsVoiceType>& voices)
 {
-    // ensure voices are up-to-date (fires VOICES_UPDATE if changed)
-    VoiceChat_RefreshVoices();
-
-    // then return the cached voices list
-    lua_createtable(L, 0, 0);
+    lua_pushresulttable(L, idx, (int)voices.size(), 0);
 
     int i = 1;
-    for (const auto& voice : g_cachedVoices)
+    for (const auto& voice : voices)
     {
-        lua_newtable(L);
+        lua_pushresultsubtable(L, -1, i++, 0, 2);
 
         lua_pushnumber(L, voice.voiceID);
         lua_setfield(L, -2, "voiceID");
@@ -493,30 +519,25 @@ static int Lua_VoiceChat_GetTtsVoices(lua_State* L)
         lua_pushstring(L, nameUtf8.c_str());
         lua_setfield(L, -2, "name");
 
-        lua_rawseti(L, -2, i++);
+        lua_pop(L, 1);
     }
+    lua_wipetail(L, -1, i);
+}
+
+static int Lua_VoiceChat_GetTtsVoices(lua_State* L)
+{
+    // ensure voices are up-to-date (fires VOICES_UPDATE if changed)
+    VoiceChat_RefreshVoices();
+
+    // then return the cached voices list
+    PushTtsVoicesTable(L, 1, VoiceChat_GetCachedVoices());
     return 1;
 }
 
 static int Lua_VoiceChat_GetRemoteTtsVoices(lua_State* L)
 {
     auto voices = VoiceChat_GetTtsVoices();
-    lua_createtable(L, 0, 0);
-
-    int i = 1;
-    for (const auto& voice : voices)
-    {
-        lua_newtable(L);
-
-        lua_pushnumber(L, voice.voiceID);
-        lua_setfield(L, -2, "voiceID");
-
-        std::string nameUtf8 = WideStringToUtf8(voice.name);
-        lua_pushstring(L, nameUtf8.c_str());
-        lua_setfield(L, -2, "name");
-
-        lua_rawseti(L, -2, i++);
-    }
+    PushTtsVoicesTable(L, 1, voices);
     return 1;
 }
 
@@ -583,7 +604,7 @@ static int Lua_TTS_RefreshVoices(lua_State* L)
 static int Lua_TTS_SetDefaultSettings(lua_State* L)
 {
     // Blizzard-like defaults: voice=1 (if available), rate=0, volume=100
-    int maxVoice = (int)VoiceChat_GetTtsVoices().size();
+    int maxVoice = (int)VoiceChat_GetCachedVoices().size();
     int voiceID  = (maxVoice > 1) ? 1 : 0;
 
     SetCVarInt(s_cvar_voiceID, voiceID);
@@ -614,7 +635,7 @@ static int Lua_TTS_SetSpeechVolume(lua_State* L)
 static int Lua_TTS_SetVoiceOptionByID(lua_State* L)
 {
     int id = (int)luaL_checknumber(L, 1);
-    int maxVoice = (int)VoiceChat_GetTtsVoices().size();
+    int maxVoice = (int)VoiceChat_GetCachedVoices().size();
     if (maxVoice == 0) return 0;
 
     id = std::clamp(id, 0, maxVoice - 1);
@@ -630,7 +651,7 @@ static int Lua_TTS_SetVoiceOptionByName(lua_State* L)
     const char* nameUtf8 = luaL_checklstring(L, 1, nullptr);
     std::wstring wname = Utf8ToWide(nameUtf8);
 
-    auto voices = VoiceChat_GetTtsVoices();
+    auto voices = VoiceChat_GetCachedVoices();
     int found = -1;
     for (size_t i = 0; i < voices.size(); ++i) {
         if (iequals(voices[i].name, wname)) { found = (int)i; break; }
@@ -701,9 +722,11 @@ static int lua_openlibttssettings(lua_State* L)
 static int OnVoiceIDChanged(Console::CVar* cvar, const char* prevVal, const char* newVal, void* udata)
 {
     int val = atoi(newVal);
-    int maxVoice = static_cast<int>(VoiceChat_GetTtsVoices().size()) - 1;
     if (val < 0) val = 0;
-    if (val > maxVoice) val = maxVoice;
+    // Config is loaded before warm-up may be done, upper bound is checked once voices are known
+    auto voices = VoiceChat_GetCachedVoices(false);
+    int maxVoice = static_cast<int>(voices.size()) - 1;
+    if (!voices.empty() && val > maxVoice) val = maxVoice;
     std::string valStr = std::to_string(val);
     SetCVarValue(cvar, valStr.c_str(), 0, 0, 0, 0);
     return 1;
@@ -740,9 +763,9 @@ void RegisterVoiceChatCVars()
 // ============================================================================
 // Library Registration & Initialization
 // ============================================================================
+// Hooks and registrations only, runs inside DllMain
 void VoiceChat::initialize()
 {
-    VoiceChat_InitVoice();
     RegisterVoiceChatCVars();
 
     Hooks::FrameXML::registerLuaLib(lua_openlibvoicechat);
@@ -753,8 +776,26 @@ void VoiceChat::initialize()
     Hooks::FrameXML::registerEvent(VOICE_CHAT_TTS_PLAYBACK_STARTED);
     Hooks::FrameXML::registerEvent(VOICE_CHAT_TTS_SPEAK_TEXT_UPDATE); // unused
     Hooks::FrameXML::registerEvent(VOICE_CHAT_TTS_VOICES_UPDATE);
+}
+
+// Runs on a background thread: SAPI voice enumeration is slow and not needed until UI asks for it.
+// Voice itself is created lazily on the main thread, SAPI callbacks are bound to its apartment
+void VoiceChat::warmUp()
+{
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    auto voices = VoiceChat_EnumTtsVoices();
+    if (SUCCEEDED(hr))
+        CoUninitialize();
 
-    VoiceChat_RefreshVoices(); // fill cache and fire VOICES_UPDATE at startup
+    {
+        std::lock_guard<std::mutex> lock(g_voicesMx);
+        // RefreshVoices may have been faster
+        if (!g_voicesReady) {
+            g_cachedVoices = std::move(voices);
+            g_voicesReady = true;
+        }
+    }
+    g_voicesCv.notify_all();
 }
 
 void VoiceChat::shutdown()
@@ -2,5 +2,6 @@
 
 namespace VoiceChat {
     void initialize();
+    void warmUp();
     void shutdown();
 }
@@ -0,0 +1,156 @@
+/*
+    Enumerates 1000 guids through mock of client enumerator, which takes C callback and user data like
+    ObjectMgr::EnumObjects_internal does, once with EnumCallback and once with std::function wrapper it
+    replaced. Callable captures 40 bytes, as snapshot building does, which is beyond small buffer of common
+    std::function implementations. Fails if results differ or EnumCallback allocates.
+
+    usage: EnumBench [--objects N] [--repeat N]
+*/
+#include "../../src/AwesomeWotlkLib/EnumCallback.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <vector>
+
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+using guid_t = uint64_t;
+
+static size_t s_allocations = 0;
+
+void* operator new(size_t size)
+{
+    s_allocations++;
+    if (void* ptr = malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+static std::vector<guid_t> s_objects;
+
+// Client side, callback is called for every object until it returns 0
+static NOINLINE int enumObjects(int (*func)(guid_t, void*), void* udata)
+{
+    for (guid_t guid : s_objects)
+        if (!func(guid, udata)) return 0;
+    return 1;
+}
+
+// Previous ObjectMgr::EnumObjects
+using EnumVisibleObject_func_t = std::function<bool(guid_t guid)>;
+static NOINLINE bool enumObjectsFunction(EnumVisibleObject_func_t func)
+{
+    struct Wrapper {
+        static int foo(guid_t guid, void* udata)
+        {
+            EnumVisibleObject_func_t& func = *(EnumVisibleObject_func_t*)udata;
+            return func(guid) ? 1 : 0;
+        }
+    };
+    return enumObjects(&Wrapper::foo, (void*)&func);
+}
+
+struct Result {
+    guid_t sum;
+    uint32_t count;
+    uint32_t matched;
+};
+
+// Both variants get the same callable: capture of 5 pointers, 40 bytes on 64-bit host
+#define ENUM_CALLABLE                                                                          \
+    [&result, &mask, &limit, &players, &skipped](guid_t guid) -> bool {                        \
+        if ((guid & mask) == mask) {                                                           \
+            players.push_back(guid);                                                           \
+            result.matched++;                                                                  \
+        } else {                                                                               \
+            skipped++;                                                                         \
+        }                                                                                      \
+        result.sum += guid;                                                                    \
+        return ++result.count < limit;                                                         \
+    }
+
+template <typename Enumerate>
+static double run(uint32_t repeat, Result& result, size_t& allocations, Enumerate&& enumerate)
+{
+    std::vector<guid_t> players;
+    players.reserve(s_objects.size());
+    guid_t mask = 0x3;
+    uint32_t limit = UINT32_MAX, skipped = 0;
+    result = {};
+
+    auto start = std::chrono::steady_clock::now();
+    size_t allocationsBefore = s_allocations;
+    for (uint32_t i = 0; i < repeat; i++) {
+        players.clear();
+        enumerate(result, mask, limit, players, skipped);
+    }
+    allocations = s_allocations - allocationsBefore;
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t objects = 1000, repeat = 100000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--objects")) objects = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--repeat")) repeat = (uint32_t)atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [--objects N] [--repeat N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!objects || !repeat) {
+        fprintf(stderr, "objects and repeat must be positive\n");
+        return 2;
+    }
+
+    guid_t seed = 0x0F00000000000001;
+    for (uint32_t i = 0; i < objects; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        s_objects.push_back(seed);
+    }
+
+    // Variants alternate, best round of each is taken
+    Result templateResult, functionResult;
+    size_t templateAllocations, functionAllocations;
+    double templateTime = 0, functionTime = 0;
+    for (int round = 0; round < 5; round++) {
+        double t = run(repeat, templateResult, templateAllocations,
+            [](Result& result, guid_t& mask, uint32_t& limit, std::vector<guid_t>& players, uint32_t& skipped) {
+                EnumCallback(enumObjects, ENUM_CALLABLE);
+            });
+        double f = run(repeat, functionResult, functionAllocations,
+            [](Result& result, guid_t& mask, uint32_t& limit, std::vector<guid_t>& players, uint32_t& skipped) {
+                enumObjectsFunction(ENUM_CALLABLE);
+            });
+        if (!round || t < templateTime) templateTime = t;
+        if (!round || f < functionTime) functionTime = f;
+    }
+
+    printf("%u objects, %u enumerations, best of 5\n", objects, repeat);
+    printf("%-14s %12s %14s %14s\n", "", "total ms", "us per enum", "allocations");
+    printf("%-14s %12.3f %14.3f %14zu\n", "EnumCallback", templateTime / 1000, templateTime / repeat, templateAllocations);
+    printf("%-14s %12.3f %14.3f %14zu\n", "std::function", functionTime / 1000, functionTime / repeat, functionAllocations);
+    printf("speedup %.2fx\n", functionTime / templateTime);
+
+    if (templateResult.sum != functionResult.sum || templateResult.count != functionResult.count
+        || templateResult.matched != functionResult.matched || templateResult.count != objects * repeat) {
+        printf("results differ\n");
+        return 1;
+    }
+    if (templateAllocations) {
+        printf("EnumCallback allocated\n");
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
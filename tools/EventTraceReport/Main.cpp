@@ -0,0 +1,158 @@
+/*
+    Reads Logs\EventTrace.bin written by C_EventTrace and prints per-event frequency and cost table.
+    Format is described in src/AwesomeWotlkLib/EventTrace.cpp.
+
+    usage: EventTraceReport EventTrace.bin [--sort count|total|self|max] [--top N]
+*/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint32_t TRACE_MAGIC = 0x54455741; // "AWET"
+constexpr uint32_t TRACE_VERSION = 1;
+constexpr uint32_t TRACE_MAX_DEPTH = 32;
+
+enum : uint8_t {
+    TRACE_RECORD_NAME = 1,
+    TRACE_RECORD_EVENT = 2,
+};
+
+#pragma pack(push, 1)
+struct TraceRecord {
+    uint8_t type;
+    uint8_t nargs;
+    uint16_t eventId;
+    uint32_t frame;
+    uint32_t duration;
+    uint32_t argHash;
+    uint16_t argTypes;
+    uint8_t depth;
+    uint8_t reserved;
+};
+#pragma pack(pop)
+static_assert(sizeof(TraceRecord) == 20, "record layout must match the recorder");
+
+struct EventStats {
+    uint64_t count = 0;
+    uint64_t total = 0; // ticks, nested events included
+    uint64_t self = 0; // ticks, nested events excluded
+    uint32_t max = 0;
+    std::vector<uint32_t> durations;
+};
+
+static bool readExact(FILE* file, void* dst, size_t size)
+{
+    return fread(dst, 1, size, file) == size;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s EventTrace.bin [--sort count|total|self|max] [--top N]\n", argv[0]);
+        return 2;
+    }
+    std::string sortBy = "self";
+    size_t top = 50;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--sort") == 0) sortBy = argv[i + 1];
+        else if (strcmp(argv[i], "--top") == 0) top = strtoul(argv[i + 1], NULL, 10);
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    uint32_t header[2];
+    uint64_t frequency, startTime;
+    if (!readExact(file, header, sizeof(header)) || !readExact(file, &frequency, 8) || !readExact(file, &startTime, 8)
+        || header[0] != TRACE_MAGIC || frequency == 0) {
+        fprintf(stderr, "%s isn't an event trace\n", argv[1]);
+        return 1;
+    }
+    if (header[1] != TRACE_VERSION)
+        fprintf(stderr, "warning: trace version %u, tool knows %u\n", header[1], TRACE_VERSION);
+
+    std::unordered_map<uint16_t, std::string> names;
+    std::unordered_map<uint16_t, EventStats> stats;
+    uint64_t childTicks[TRACE_MAX_DEPTH + 1] = {}; // time of finished children per depth
+    uint32_t firstFrame = UINT32_MAX, lastFrame = 0;
+    uint64_t records = 0;
+
+    int type;
+    while ((type = fgetc(file)) != EOF) {
+        if (type == TRACE_RECORD_NAME) {
+            uint16_t id;
+            uint8_t len;
+            char name[256];
+            if (!readExact(file, &id, 2) || !readExact(file, &len, 1) || !readExact(file, name, len)) break;
+            names[id].assign(name, len);
+        } else if (type == TRACE_RECORD_EVENT) {
+            TraceRecord record;
+            record.type = (uint8_t)type;
+            if (!readExact(file, (char*)&record + 1, sizeof(record) - 1)) break;
+            records++;
+            firstFrame = std::min(firstFrame, record.frame);
+            lastFrame = std::max(lastFrame, record.frame);
+
+            // Nested events finish and are written before their parent
+            uint32_t depth = std::min<uint32_t>(record.depth, TRACE_MAX_DEPTH - 1);
+            uint64_t children = childTicks[depth + 1];
+            childTicks[depth + 1] = 0;
+            childTicks[depth] += record.duration;
+
+            EventStats& entry = stats[record.eventId];
+            entry.count++;
+            entry.total += record.duration;
+            entry.self += record.duration > children ? record.duration - children : 0;
+            entry.max = std::max(entry.max, record.duration);
+            entry.durations.push_back(record.duration);
+        } else {
+            fprintf(stderr, "unknown record type %d at offset %ld, stopping\n", type, ftell(file) - 1);
+            break;
+        }
+    }
+    fclose(file);
+
+    if (!records) {
+        printf("no events recorded\n");
+        return 0;
+    }
+
+    std::vector<std::pair<uint16_t, EventStats*>> rows;
+    for (auto& [id, entry] : stats)
+        rows.push_back({ id, &entry });
+    std::sort(rows.begin(), rows.end(), [&sortBy](auto& a, auto& b) {
+        if (sortBy == "count") return a.second->count > b.second->count;
+        if (sortBy == "total") return a.second->total > b.second->total;
+        if (sortBy == "max") return a.second->max > b.second->max;
+        return a.second->self > b.second->self;
+    });
+
+    uint32_t frames = lastFrame - firstFrame + 1;
+    uint64_t allSelf = 0;
+    for (auto& [id, entry] : stats)
+        allSelf += entry.self;
+    auto ms = [frequency](uint64_t ticks) { return ticks * 1000.0 / frequency; };
+
+    printf("%llu events over %u frames, %.1f ms spent in dispatch\n\n", (unsigned long long)records, frames, ms(allSelf));
+    printf("%-40s %10s %9s %11s %11s %6s %9s %9s %9s\n", "event", "count", "per frame", "total ms", "self ms", "self%", "mean us", "p95 us", "max us");
+    for (size_t i = 0; i < rows.size() && i < top; i++) {
+        auto& [id, entry] = rows[i];
+        auto name = names.find(id);
+        std::vector<uint32_t>& d = entry->durations;
+        size_t p95 = std::min(d.size() - 1, d.size() * 95 / 100);
+        std::nth_element(d.begin(), d.begin() + p95, d.end());
+        printf("%-40s %10llu %9.2f %11.2f %11.2f %6.1f %9.1f %9.1f %9.1f\n",
+            name != names.end() ? name->second.c_str() : ("#" + std::to_string(id)).c_str(),
+            (unsigned long long)entry->count, (double)entry->count / frames,
+            ms(entry->total), ms(entry->self), allSelf ? entry->self * 100.0 / allSelf : 0.0,
+            ms(entry->total) * 1000.0 / entry->count, ms(d[p95]) * 1000.0, ms(entry->max) * 1000.0);
+    }
+    return 0;
+}
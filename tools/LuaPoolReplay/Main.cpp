@@ -0,0 +1,258 @@
+/*
+    Replays deterministic synthetic lua allocation trace through SlabPool with host malloc as fallback
+    allocator and region committed by page source which only counts pages. Trace is shaped after lua workload: short
+    strings, table headers, closures, array parts doubling through realloc, some big blocks, steady churn
+    and periodic sweeps freeing large share of live blocks.
+
+    Live bytes and internal fragmentation are checked against values computed from the trace at every
+    sweep, final fragmentation against values recorded for default trace. Then same trace is timed with
+    pool and with fallback allocator alone.
+
+    usage: LuaPoolReplay [--ops N] [--seed N] [--repeat N]
+*/
+#include "../../src/AwesomeWotlkLib/SlabPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr size_t REGION_SIZE = 64 * 1024 * 1024;
+constexpr uint32_t DEFAULT_OPS = 2000000;
+constexpr uint32_t DEFAULT_SEED = 1;
+constexpr uint32_t SWEEP_INTERVAL = 100000;
+
+// Recorded for default ops and seed, pool layout change shows up here
+constexpr size_t EXPECTED_COMMITTED = 4352 * 1024;
+constexpr double EXPECTED_FRAGMENTATION = 0.715725;
+constexpr double EXPECTED_INTERNAL_FRAGMENTATION = 0.062827;
+
+enum class OpType : uint8_t { Alloc, Realloc, Free, Sweep };
+
+struct Op {
+    OpType type;
+    uint32_t id; // block index, Sweep: share of blocks freed in percent
+    uint32_t size;
+};
+
+struct Block {
+    void* ptr;
+    uint32_t size;
+};
+
+struct Random {
+    uint32_t state;
+
+    uint32_t next()
+    {
+        state = state * 1664525 + 1013904223;
+        return state >> 8;
+    }
+
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+static size_t s_commits = 0;
+
+// Host memory is committed on first touch anyway, only count pages
+static bool commitPage(void*, size_t)
+{
+    s_commits++;
+    return true;
+}
+
+static void* hostAlloc(void*, void* ptr, size_t, size_t nsize)
+{
+    if (!nsize) {
+        free(ptr);
+        return NULL;
+    }
+    return realloc(ptr, nsize);
+}
+
+static uint32_t randomSize(Random& rng)
+{
+    uint32_t kind = rng.below(100);
+    if (kind < 40) return 17 + rng.below(8) * rng.below(8); // string header + short text
+    if (kind < 65) return rng.below(2) ? 32 : 40; // table
+    if (kind < 80) return 20 + 4 * rng.below(6); // closure with upvalues
+    if (kind < 90) return 16 << rng.below(7); // array part
+    return 300 + rng.below(3700);
+}
+
+// Ids are slots of live block list, freed slot is filled by last block as replay does it too
+static std::vector<Op> makeTrace(uint32_t ops, uint32_t seed)
+{
+    std::vector<Op> trace;
+    trace.reserve(ops + ops / SWEEP_INTERVAL);
+    std::vector<uint32_t> sizes;
+    Random rng = { seed };
+    for (uint32_t i = 0; i < ops; i++) {
+        if (i && i % SWEEP_INTERVAL == 0) {
+            uint32_t share = 20 + rng.below(40);
+            trace.push_back({ OpType::Sweep, share, rng.next() });
+            // Sweep is replayed with its own generator seeded by size, mirror it
+            Random sweep = { trace.back().size };
+            for (size_t j = 0; j < sizes.size();) {
+                if (sweep.below(100) < share) {
+                    sizes[j] = sizes.back();
+                    sizes.pop_back();
+                } else {
+                    j++;
+                }
+            }
+        }
+
+        uint32_t roll = rng.below(100);
+        uint32_t allocShare = i < ops / 10 ? 75 : 50;
+        if (sizes.empty() || roll < allocShare) {
+            uint32_t size = randomSize(rng);
+            trace.push_back({ OpType::Alloc, (uint32_t)sizes.size(), size });
+            sizes.push_back(size);
+        } else if (roll < allocShare + 15) {
+            uint32_t id = rng.below((uint32_t)sizes.size());
+            uint32_t size = rng.below(3) ? sizes[id] * 2 : (sizes[id] + 1) / 2;
+            size = (std::min)(size, 1u << 16);
+            trace.push_back({ OpType::Realloc, id, size });
+            sizes[id] = size;
+        } else {
+            uint32_t id = rng.below((uint32_t)sizes.size());
+            trace.push_back({ OpType::Free, id, sizes[id] });
+            sizes[id] = sizes.back();
+            sizes.pop_back();
+        }
+    }
+    return trace;
+}
+
+static size_t classSizeOf(size_t size)
+{
+    for (size_t i = 0; i < SlabPool::NUM_CLASSES; i++)
+        if (SlabPool::getClassStats(i).size >= size)
+            return SlabPool::getClassStats(i).size;
+    return 0;
+}
+
+static bool checkStats(const std::vector<Block>& blocks, size_t op)
+{
+    size_t live = 0, pooled = 0, capacity = 0;
+    for (const Block& block : blocks) {
+        live += block.size;
+        if (SlabPool::isPooled(block.ptr)) {
+            pooled += block.size;
+            capacity += classSizeOf(block.size);
+        }
+    }
+    double internal = capacity ? 1.0 - (double)pooled / capacity : 0.0;
+
+    SlabPool::Stats stats = SlabPool::getStats();
+    bool ok = stats.liveBytes == live && stats.pooledBytes == pooled && stats.pooledBytes + stats.fallbackBytes == live
+        && std::fabs(stats.internalFragmentation - internal) < 1e-9;
+    if (!ok)
+        printf("op %zu: live %zu pooled %zu fallback %zu internal %.6f, expected live %zu pooled %zu internal %.6f\n",
+            op, stats.liveBytes, stats.pooledBytes, stats.fallbackBytes, stats.internalFragmentation, live, pooled, internal);
+    return ok;
+}
+
+// Returns elapsed microseconds, or -1 if check failed. Stats before remaining blocks are freed go to end
+static double replay(const std::vector<Op>& trace, bool check, SlabPool::Stats* end)
+{
+    std::vector<Block> blocks;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < trace.size(); i++) {
+        const Op& op = trace[i];
+        switch (op.type) {
+        case OpType::Alloc:
+            blocks.push_back({ SlabPool::alloc(NULL, 0, op.size), op.size });
+            break;
+        case OpType::Realloc: {
+            Block& block = blocks[op.id];
+            block.ptr = SlabPool::alloc(block.ptr, block.size, op.size);
+            block.size = op.size;
+            break;
+        }
+        case OpType::Free:
+            SlabPool::alloc(blocks[op.id].ptr, blocks[op.id].size, 0);
+            blocks[op.id] = blocks.back();
+            blocks.pop_back();
+            break;
+        case OpType::Sweep: {
+            if (check && !checkStats(blocks, i)) return -1;
+            Random sweep = { op.size };
+            for (size_t j = 0; j < blocks.size();) {
+                if (sweep.below(100) < op.id) {
+                    SlabPool::alloc(blocks[j].ptr, blocks[j].size, 0);
+                    blocks[j] = blocks.back();
+                    blocks.pop_back();
+                } else {
+                    j++;
+                }
+            }
+            break;
+        }
+        }
+    }
+    if (check && !checkStats(blocks, trace.size())) return -1;
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    if (end) *end = SlabPool::getStats();
+
+    for (const Block& block : blocks)
+        SlabPool::alloc(block.ptr, block.size, 0);
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t ops = DEFAULT_OPS, seed = DEFAULT_SEED, repeat = 5;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--ops")) ops = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--seed")) seed = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--repeat")) repeat = (uint32_t)atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [--ops N] [--seed N] [--repeat N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!ops || !repeat) {
+        fprintf(stderr, "ops and repeat must be positive\n");
+        return 2;
+    }
+
+    char* region = (char*)malloc(REGION_SIZE);
+    SlabPool::initialize(region, REGION_SIZE, commitPage);
+    SlabPool::setFallback(hostAlloc, NULL, 0);
+    std::vector<Op> trace = makeTrace(ops, seed);
+
+    SlabPool::Stats stats;
+    SlabPool::setEnabled(true);
+    if (replay(trace, true, &stats) < 0) return 1;
+    printf("%zu ops, %zu bytes live at end, %zu KB committed\n", trace.size(), stats.liveBytes, stats.committedBytes / 1024);
+    printf("fragmentation %.6f, internal %.6f\n", stats.fragmentation, stats.internalFragmentation);
+
+    bool ok = s_commits * SlabPool::PAGE_SIZE == stats.committedBytes;
+    if (!ok) printf("page source committed %zu pages, pool reports %zu KB\n", s_commits, stats.committedBytes / 1024);
+    if (ops == DEFAULT_OPS && seed == DEFAULT_SEED) {
+        ok = ok && stats.committedBytes == EXPECTED_COMMITTED && std::fabs(stats.fragmentation - EXPECTED_FRAGMENTATION) < 1e-6
+            && std::fabs(stats.internalFragmentation - EXPECTED_INTERNAL_FRAGMENTATION) < 1e-6;
+        if (!ok)
+            printf("expected %zu KB committed, fragmentation %.6f, internal %.6f\n", EXPECTED_COMMITTED / 1024,
+                EXPECTED_FRAGMENTATION, EXPECTED_INTERNAL_FRAGMENTATION);
+    }
+
+    double pooledBest = 0, fallbackBest = 0;
+    for (uint32_t i = 0; i < repeat; i++) {
+        SlabPool::setEnabled(true);
+        double pooled = replay(trace, false, NULL);
+        SlabPool::setEnabled(false);
+        double fallback = replay(trace, false, NULL);
+        if (!i || pooled < pooledBest) pooledBest = pooled;
+        if (!i || fallback < fallbackBest) fallbackBest = fallback;
+    }
+    printf("%-10s %12s %12s\n", "", "total ms", "ns per op");
+    printf("%-10s %12.3f %12.1f\n", "pool", pooledBest / 1000, pooledBest * 1000 / trace.size());
+    printf("%-10s %12.3f %12.1f\n", "fallback", fallbackBest / 1000, fallbackBest * 1000 / trace.size());
+    free(region);
+    return ok ? 0 : 1;
+}
\ No newline at end of file
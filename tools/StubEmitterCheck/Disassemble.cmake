@@ -0,0 +1,16 @@
+# Dumps thunks of StubEmitterCheck and fails if objdump can't decode any of them
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+execute_process(COMMAND ${CHECK_TOOL} --dump ${WORK_DIR} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "StubEmitterCheck failed")
+endif()
+
+file(GLOB thunks ${WORK_DIR}/*.bin)
+foreach(thunk ${thunks})
+    execute_process(COMMAND ${OBJDUMP} -D -b binary -m i386 ${thunk} OUTPUT_VARIABLE listing RESULT_VARIABLE result)
+    if(NOT result EQUAL 0 OR listing MATCHES "\\(bad\\)")
+        message(FATAL_ERROR "${thunk} doesn't disassemble:\n${listing}")
+    endif()
+    message(STATUS "${listing}")
+endforeach()
@@ -0,0 +1,92 @@
+/*
+    Encodes StubEmitter thunks shaped as the hooks in Hooks.cpp at a fixed base and compares them with
+    reference bytes checked against a disassembler. Encoder is platform independent, so this runs on host.
+
+    usage: StubEmitterCheck [--dump DIR]
+    --dump writes every thunk to DIR/<name>.bin, e.g. for: objdump -D -b binary -m i386 DIR/returned.bin
+*/
+#include "../../src/AwesomeWotlkLib/StubEmitter.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace StubEmitter;
+
+constexpr uintptr_t STUB_BASE = 0x10000000;
+static const void* const CALLBACK_ADDRESS = (const void*)0x10001000;
+
+struct Case {
+    const char* name;
+    Desc desc;
+    std::vector<uint8_t> expected;
+};
+
+static const std::vector<Case> s_cases = {
+    // push eax; call cb; pop eax; ret
+    { "return", { {}, SaveEax, CALLBACK_ADDRESS, {}, Resume::Return },
+        { 0x50, 0xE8, 0xFA, 0x0F, 0x00, 0x00, 0x58, 0xC3 } },
+    // lea esp, [esp - 4]; push eax; push ecx; push edx; push [ebp + 0xC]; push ebp; add [esp], 8; call cb;
+    // add esp, 8; mov [esp + 0xC], eax; pop edx; pop ecx; pop eax; ret
+    { "returned", { {}, SaveEax | SaveEcx | SaveEdx, CALLBACK_ADDRESS, { argAddress(Ebp, 0x8), argMemory(Ebp, 0xC) }, Resume::Returned },
+        { 0x8D, 0x64, 0x24, 0xFC, 0x50, 0x51, 0x52, 0xFF, 0x75, 0x0C, 0x55, 0x83, 0x04, 0x24, 0x08, 0xE8, 0xEC, 0x0F, 0x00, 0x00,
+          0x83, 0xC4, 0x08, 0x89, 0x44, 0x24, 0x0C, 0x5A, 0x59, 0x58, 0xC3 } },
+    // pop ebx; mov esp, ebp; pop ebp; push eax; call cb; pop eax; ret
+    { "prologue", { { 0x5B, 0x8B, 0xE5, 0x5D }, SaveEax, CALLBACK_ADDRESS, {}, Resume::Return },
+        { 0x5B, 0x8B, 0xE5, 0x5D, 0x50, 0xE8, 0xF6, 0x0F, 0x00, 0x00, 0x58, 0xC3 } },
+    // push ecx; call cb; pop ecx; jmp [0xABCDEF]
+    { "jump_indirect", { {}, SaveEcx, CALLBACK_ADDRESS, {}, Resume::JumpIndirect, 0x00ABCDEF },
+        { 0x51, 0xE8, 0xFA, 0x0F, 0x00, 0x00, 0x59, 0xFF, 0x25, 0xEF, 0xCD, 0xAB, 0x00 } },
+    // push eax; pushfd; push 0x12345678; push esp; add [esp], 0x10C; push [esp + 0x14]; push ecx; call cb;
+    // add esp, 0x10; popfd; pop eax; jmp 0x401000. Esp arguments resolve to entry esp + 0x100 and entry esp + 4
+    { "esp_args", { {}, SaveFlags | SaveEax, CALLBACK_ADDRESS,
+        { argValue(Ecx), argMemory(Esp, 4), argAddress(Esp, 0x100), argImmediate(0x12345678) }, Resume::Jump, 0x00401000 },
+        { 0x50, 0x9C, 0x68, 0x78, 0x56, 0x34, 0x12, 0x54, 0x81, 0x04, 0x24, 0x0C, 0x01, 0x00, 0x00, 0xFF, 0x74, 0x24, 0x14,
+          0x51, 0xE8, 0xE7, 0x0F, 0x00, 0x00, 0x83, 0xC4, 0x10, 0x9D, 0x58, 0xE9, 0xDD, 0x0F, 0x40, 0xF0 } },
+};
+
+static void printBytes(const char* label, const std::vector<uint8_t>& bytes)
+{
+    printf("  %-9s", label);
+    for (uint8_t b : bytes)
+        printf(" %02X", b);
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* dumpDir = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--dump") && i + 1 < argc) {
+            dumpDir = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--dump DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failed = 0;
+    for (const Case& c : s_cases) {
+        std::vector<uint8_t> bytes(encode(c.desc, STUB_BASE, NULL));
+        size_t written = encode(c.desc, STUB_BASE, bytes.data());
+        bool ok = written == bytes.size() && bytes == c.expected;
+        printf("%-14s %s\n", c.name, ok ? "ok" : "MISMATCH");
+        if (!ok) {
+            printBytes("expected", c.expected);
+            printBytes("actual", bytes);
+            failed++;
+        }
+
+        if (dumpDir) {
+            std::string path = std::string(dumpDir) + "/" + c.name + ".bin";
+            FILE* file = fopen(path.c_str(), "wb");
+            if (!file) {
+                fprintf(stderr, "can't write %s\n", path.c_str());
+                return 2;
+            }
+            fwrite(bytes.data(), 1, bytes.size(), file);
+            fclose(file);
+        }
+    }
+    return failed ? 1 : 0;
+}
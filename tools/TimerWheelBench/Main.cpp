@@ -0,0 +1,145 @@
+/*
+    Runs 1000 tickers with intervals from 0.1 to 5 seconds over simulated 60 fps frames, once on TimerWheel
+    as C_Timer.NewTicker does and once with OnUpdate accumulator idiom, where every ticker is visited each
+    frame to add elapsed time. Accumulator handler is called through pointer like script handler would be,
+    but stays native, so its cost is lower bound of the Lua version. Fails if fire counts of any ticker
+    are off from what its interval gives.
+
+    usage: TimerWheelBench [--frames N] [--tickers N] [--repeat N]
+*/
+#include "../../src/AwesomeWotlkLib/TimerWheel.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr uint64_t FRAME_US = 16667;
+
+struct Ticker {
+    double interval; // seconds
+    double elapsed;
+};
+
+using OnUpdateFn = void (*)(Ticker& ticker, double elapsed, uint32_t& fired);
+
+static void onUpdateAccumulator(Ticker& ticker, double elapsed, uint32_t& fired)
+{
+    ticker.elapsed += elapsed;
+    if (ticker.elapsed >= ticker.interval) {
+        ticker.elapsed = 0;
+        fired++;
+    }
+}
+
+static OnUpdateFn volatile s_onUpdate = onUpdateAccumulator;
+
+static std::vector<double> makeIntervals(size_t count)
+{
+    std::vector<double> intervals(count);
+    uint32_t seed = 12345;
+    for (double& interval : intervals) {
+        seed = seed * 1664525 + 1013904223;
+        interval = (10 + (seed >> 8) % 491) * 0.01; // 0.1 .. 5.0 seconds, whole ticks
+    }
+    return intervals;
+}
+
+static double runWheel(const std::vector<double>& intervals, uint32_t frames, std::vector<uint32_t>& fired)
+{
+    fired.assign(intervals.size(), 0);
+    std::vector<TimerWheel::Due> due;
+    auto start = std::chrono::steady_clock::now();
+
+    TimerWheel::reset(0);
+    for (size_t i = 0; i < intervals.size(); i++)
+        TimerWheel::schedule((uint32_t)std::lround(intervals[i] * 1000 / TimerWheel::TICK_MS), -1, (uint32_t)i);
+
+    for (uint32_t frame = 1; frame <= frames; frame++) {
+        TimerWheel::advance((uint32_t)(frame * FRAME_US / 1000 / TimerWheel::TICK_MS), due);
+        for (auto [node, id] : due) {
+            if (!TimerWheel::isActive(node, id)) continue;
+            fired[TimerWheel::getUserData(node)]++;
+            TimerWheel::rearm(node);
+        }
+        due.clear();
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double runAccumulator(const std::vector<double>& intervals, uint32_t frames, std::vector<uint32_t>& fired)
+{
+    fired.assign(intervals.size(), 0);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Ticker> tickers(intervals.size());
+    for (size_t i = 0; i < intervals.size(); i++)
+        tickers[i] = { intervals[i], 0 };
+
+    OnUpdateFn onUpdate = s_onUpdate;
+    for (uint32_t frame = 1; frame <= frames; frame++)
+        for (size_t i = 0; i < tickers.size(); i++)
+            onUpdate(tickers[i], FRAME_US / 1e6, fired[i]);
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Both fire on first frame at or after due time and count next period from it,
+// so each period is interval rounded up to whole frames, one frame more at most
+static bool checkCounts(const char* name, const std::vector<double>& intervals, uint32_t frames, const std::vector<uint32_t>& fired)
+{
+    double duration = frames * FRAME_US / 1e6, frame = FRAME_US / 1e6;
+    for (size_t i = 0; i < intervals.size(); i++) {
+        uint32_t most = (uint32_t)(duration / intervals[i]);
+        uint32_t least = (uint32_t)(duration / (intervals[i] + 2 * frame));
+        if (fired[i] < least || fired[i] > most) {
+            printf("%s: ticker %zu with interval %.2f fired %u times, expected %u..%u\n", name, i, intervals[i], fired[i], least, most);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = 36000, tickers = 1000, repeat = 5;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--frames")) frames = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--tickers")) tickers = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--repeat")) repeat = (uint32_t)atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [--frames N] [--tickers N] [--repeat N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!frames || !tickers || !repeat) {
+        fprintf(stderr, "frames, tickers and repeat must be positive\n");
+        return 2;
+    }
+
+    std::vector<double> intervals = makeIntervals(tickers);
+    std::vector<uint32_t> wheelFired, accumulatorFired;
+    double wheelBest = 0, accumulatorBest = 0;
+    for (uint32_t i = 0; i < repeat; i++) {
+        double wheel = runWheel(intervals, frames, wheelFired);
+        double accumulator = runAccumulator(intervals, frames, accumulatorFired);
+        if (!i || wheel < wheelBest) wheelBest = wheel;
+        if (!i || accumulator < accumulatorBest) accumulatorBest = accumulator;
+    }
+
+    uint64_t wheelTotal = 0, accumulatorTotal = 0;
+    for (uint32_t i = 0; i < tickers; i++) {
+        wheelTotal += wheelFired[i];
+        accumulatorTotal += accumulatorFired[i];
+    }
+
+    printf("%u tickers, %u frames of %.3f ms, best of %u\n", tickers, frames, FRAME_US / 1000.0, repeat);
+    printf("%-12s %12s %14s %10s\n", "", "total ms", "ns per frame", "fired");
+    printf("%-12s %12.3f %14.1f %10llu\n", "wheel", wheelBest / 1000, wheelBest * 1000 / frames, (unsigned long long)wheelTotal);
+    printf("%-12s %12.3f %14.1f %10llu\n", "accumulator", accumulatorBest / 1000, accumulatorBest * 1000 / frames, (unsigned long long)accumulatorTotal);
+    printf("speedup %.1fx\n", accumulatorBest / wheelBest);
+
+    bool ok = checkCounts("wheel", intervals, frames, wheelFired);
+    ok = checkCounts("accumulator", intervals, frames, accumulatorFired) && ok;
+    return ok ? 0 : 1;
+}
\ No newline at end of file
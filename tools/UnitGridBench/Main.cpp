@@ -0,0 +1,135 @@
+/*
+    Places 1000 units as in crowded zone or battleground, moves them every frame and runs radius query
+    around every unit, as e.g. counting injured allies in range of each group member does. Each frame
+    is done once with UnitGrid as Objects::queryRadius does, grid rebuild included, and once with brute
+    force loop over all units. Fails if both don't return the same slots for any query.
+
+    usage: UnitGridBench [--frames N] [--units N] [--radius R] [--spread R]
+*/
+#include "../../src/AwesomeWotlkLib/UnitGrid.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Position {
+    float x, y;
+};
+
+struct Random {
+    uint32_t state;
+
+    uint32_t next()
+    {
+        state = state * 1664525 + 1013904223;
+        return state >> 8;
+    }
+
+    float uniform(float min, float max) { return min + (max - min) * (next() & 0xFFFF) / 65535.f; }
+};
+
+static void bruteForce(const std::vector<Position>& positions, const std::vector<uint32_t>& flags, float x, float y,
+    float radius, uint32_t requiredFlags, std::vector<int>& out)
+{
+    float radiusSq = radius * radius;
+    for (size_t slot = 0; slot < positions.size(); slot++) {
+        float dx = positions[slot].x - x, dy = positions[slot].y - y;
+        if (dx * dx + dy * dy <= radiusSq && (flags[slot] & requiredFlags) == requiredFlags)
+            out.push_back((int)slot);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = 200, units = 1000;
+    float radius = 30.f, spread = 300.f;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--frames")) frames = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--units")) units = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--radius")) radius = (float)atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--spread")) spread = (float)atof(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [--frames N] [--units N] [--radius R] [--spread R]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!frames || !units) {
+        fprintf(stderr, "frames and units must be positive\n");
+        return 2;
+    }
+
+    // Half of units stand in few clusters, rest is scattered over the area
+    Random rng = { 1 };
+    std::vector<Position> positions(units);
+    std::vector<uint32_t> flags(units);
+    for (uint32_t i = 0; i < units; i++) {
+        if (i % 2) {
+            float cx = (float)(i % 8) * spread / 8, cy = (float)(i % 5) * spread / 5;
+            positions[i] = { cx + rng.uniform(-15.f, 15.f), cy + rng.uniform(-15.f, 15.f) };
+        } else {
+            positions[i] = { rng.uniform(0.f, spread), rng.uniform(0.f, spread) };
+        }
+        flags[i] = rng.next() & 0x7;
+    }
+
+    UnitGrid grid;
+    std::vector<int> gridResult, bruteResult;
+    double gridTime = 0, bruteTime = 0;
+    uint64_t found = 0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        for (Position& pos : positions) {
+            pos.x += rng.uniform(-0.5f, 0.5f);
+            pos.y += rng.uniform(-0.5f, 0.5f);
+        }
+        uint32_t requiredFlags = frame % 2 ? 0x1 : 0;
+
+        auto start = std::chrono::steady_clock::now();
+        grid.build(positions);
+        size_t gridCount = 0;
+        for (const Position& pos : positions) {
+            gridResult.clear();
+            grid.query(positions, flags, pos.x, pos.y, radius, requiredFlags, gridResult);
+            gridCount += gridResult.size();
+        }
+        auto mid = std::chrono::steady_clock::now();
+        size_t bruteCount = 0;
+        for (const Position& pos : positions) {
+            bruteResult.clear();
+            bruteForce(positions, flags, pos.x, pos.y, radius, requiredFlags, bruteResult);
+            bruteCount += bruteResult.size();
+        }
+        auto end = std::chrono::steady_clock::now();
+        gridTime += std::chrono::duration<double, std::micro>(mid - start).count();
+        bruteTime += std::chrono::duration<double, std::micro>(end - mid).count();
+        found += gridCount;
+
+        if (gridCount != bruteCount) {
+            printf("frame %u: grid found %zu units, brute force %zu\n", frame, gridCount, bruteCount);
+            return 1;
+        }
+        // Order differs, grid walks cells, compare sets for every query of first frames only
+        if (frame < 3) {
+            for (const Position& pos : positions) {
+                gridResult.clear();
+                bruteResult.clear();
+                grid.query(positions, flags, pos.x, pos.y, radius, requiredFlags, gridResult);
+                bruteForce(positions, flags, pos.x, pos.y, radius, requiredFlags, bruteResult);
+                std::sort(gridResult.begin(), gridResult.end());
+                if (gridResult != bruteResult) {
+                    printf("frame %u: query at %.2f, %.2f differs from brute force\n", frame, pos.x, pos.y);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    printf("%u units over %.0f yards, radius %.0f, %u frames of %u queries, %.1f units per query\n", units, spread, radius,
+        frames, units, (double)found / frames / units);
+    printf("%-12s %12s %14s\n", "", "total ms", "us per frame");
+    printf("%-12s %12.3f %14.1f\n", "grid", gridTime / 1000, gridTime / frames);
+    printf("%-12s %12.3f %14.1f\n", "brute force", bruteTime / 1000, bruteTime / frames);
+    printf("speedup %.1fx\n", bruteTime / gridTime);
+    return 0;
+}
\ No newline at end of file